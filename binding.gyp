@@ -1,8 +1,29 @@
 {
 	"targets": [
+		{
+			"target_name": "geodata_core",
+			"type": "static_library",
+			"sources": [ "src/geodata_core.cc" ],
+			"direct_dependent_settings": {
+				"include_dirs": [ "src" ]
+			},
+			"link_settings": {
+				"libraries": [ "-lpthread" ],
+				"conditions": [
+					[ "OS=='linux'", { "libraries": [ "-lrt" ] } ]
+				]
+			}
+		},
 		{
 			"target_name": "geodata",
-			"sources": [ "src/geodata.cc" ]	
+			"sources": [ "src/geodata.cc" ],
+			"dependencies": [ "geodata_core" ]
+		},
+		{
+			"target_name": "geodata-classify",
+			"type": "executable",
+			"sources": [ "src/classify.cc" ],
+			"dependencies": [ "geodata_core" ]
 		}
 	]
 }
\ No newline at end of file
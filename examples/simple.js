@@ -4,3 +4,71 @@ var geo = new GeoData('<path to geodat file>');
 
 console.log(geo.contains(-68.378906, 31.723495)); // atlantic ocean
 console.log(geo.contains(-98.173828, 31.688445)); // USA
+
+console.log(geo.lookup(-98.173828, 31.688445)); // index of the containing polygon, -1 if none
+
+// files with a PROP trailer carry per polygon columns, resolved natively
+console.log(geo.lookupProps(-98.173828, 31.688445, ['id', 'iso'])); // { id: 840, iso: 'US' }, null outside every polygon
+console.log(geo.properties(geo.lookup(-98.173828, 31.688445))); // every column of a polygon by index, i.e. from lookupBatch
+
+// files with a PRNT trailer nest polygons, lookups descend from the top level through the children of each hit
+console.log(geo.lookupPath(-98.173828, 31.688445)); // Int32Array [country, state, county]
+
+// [pointIndex, polygonIndex, ...] for every fix where the containing polygon changes
+var track = new Float64Array([-68.378906, 31.723495, -80.0, 31.7, -98.173828, 31.688445]);
+console.log(geo.classifyTrack(track));
+
+// batch lookups run on a native thread pool, results are written into the Int32Array
+var points = new Float64Array([-68.378906, 31.723495, -98.173828, 31.688445]);
+var results = new Int32Array(points.length / 2);
+geo.lookupBatch(points, results, {sort: true}); // sort: visit the points in morton order
+console.log(results);
+
+// datasets are shared process wide, a handle wraps the same copy again without reloading it. the module isn't context
+// aware, so handles only work within the main isolate, not in worker threads
+var handle = geo.handle();
+var shared = GeoData.fromHandle(handle);
+console.log(shared.contains(-98.173828, 31.688445));
+
+// the first process loads the file into the "countries" shared memory segment, later ones attach to it
+var countries = new GeoData('<path to geodat file>', {shared: 'countries'});
+var attached = new GeoData(null, {shared: 'countries'}); // attach only, the segment has to exist
+
+// polygons and indexes in 2MB pages, stats() reports where the memory ended up
+var large = new GeoData('<path to geodat file>', {hugePages: true, numa: true}); // numa: one copy per socket
+console.log(large.stats()); // { polygons, memory, storage, hugePageMemory, replicas }
+
+// adaptive quadtree of in/out cells, lookups descend a few levels instead of scanning every polygon
+var fast = new GeoData('<path to geodat file>', {quadtree: {depth: 16, edges: 8, memory: 64 * 1024 * 1024}});
+console.log(fast.lookup(-98.173828, 31.688445), fast.stats().quadNodes);
+
+// exact predicates, points on or within rounding distance of a border get the same answer from every index
+var exact = new GeoData('<path to geodat file>', {quadtree: true, robust: true});
+console.log(exact.lookup(-98.173828, 31.688445));
+
+// lookups outside the dataset extent or the given [minLng, minLat, maxLng, maxLat] domain return -1 right away
+var usa = new GeoData('<path to geodat file>', {domain: [-125, 24, -66, 50]});
+console.log(usa.lookup(2.35, 48.85)); // -1
+
+// meters to the nearest border, with the polygon and edge it belongs to
+console.log(geo.distanceToBoundary(-98.173828, 31.688445)); // { distance, polygon, edge }
+
+// closest polygons when the point is outside all of them, 0 meters for the one containing it
+console.log(geo.nearest(-68.378906, 31.723495, 3)); // [{ polygon, distance }, ...]
+
+// Uint32Array of polygon indices, by box overlap alone unless exact
+console.log(geo.queryBox(-100, 30, -90, 40)); // viewport culling
+console.log(geo.queryBox(-100, 30, -90, 40, {exact: true}));
+console.log(geo.queryBox(170, -20, -170, -10)); // min lng above max lng wraps across the antimeridian
+console.log(geo.queryRadius(-98.173828, 31.688445, 50000, {exact: true})); // within 50km
+
+// classify a drawn ring of lng/lat pairs against the stored polygons, both return a Uint32Array of polygon indices
+var fence = new Float64Array([-99, 31, -97, 31, -97, 32, -99, 32]);
+console.log(geo.intersects(fence)); // polygons sharing any point with the ring
+console.log(geo.within(fence)); // polygons the ring lies inside of
+
+// several datasets answered in one call, every layer is opened with the same options
+var layers = new GeoData.Layers({countries: '<path to geodat file>', timezones: '<path to geodat file>'}, {quadtree: true});
+console.log(layers.lookupAll(-98.173828, 31.688445)); // { countries: 12, timezones: 3 }
+console.log(layers.lookupAll(-98.173828, 31.688445, new Int32Array(2))); // same indices in layer order, no allocation
+console.log(layers.layer('countries').nearest(-68.378906, 31.723495, 1)); // a GeoData sharing the layer's dataset
@@ -0,0 +1,212 @@
+// geodata-classify: streams lng,lat records through the geodata_core library without node
+//
+// usage: geodata-classify [-q] [-r] [-s] [-n points] <geodat file> [input file]
+//
+// every input line holds a longitude and a latitude separated by a comma, tab, semicolon or spaces, anything after
+// them is ignored. one polygon index is written per input line, -1 for points outside every polygon and for lines
+// that don't parse. input is read in large chunks and classified in batches on the shared thread pool, so memory
+// stays bounded by the batch size whatever the input length
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <math.h>
+#include <getopt.h>
+
+#include "geodata.h"
+
+#define GEO_DATA_CLI_READ (1024 * 1024)
+#define GEO_DATA_CLI_POINTS (64 * 1024)
+
+typedef struct {
+    double *coords;
+    int *results;
+    unsigned int num_points;
+    unsigned int max_points;
+    unsigned int flags;
+    char *out; // formatted results, flushed to stdout once per batch
+} geo_data_cli_batch;
+
+static void geo_data_cli_usage(void) {
+    fprintf(stderr,
+            "usage: geodata-classify [-q] [-r] [-s] [-n points] <geodat file> [input file]\n"
+            "  -q  build the quadtree index\n"
+            "  -r  exact predicates for points on or near an edge\n"
+            "  -s  visit every batch in morton order\n"
+            "  -n  points per batch, %u by default\n",
+            GEO_DATA_CLI_POINTS);
+}
+
+// "lng,lat" and friends, NaN for lines that don't parse so they classify as -1
+static void geo_data_cli_parse(const char *line, const char *end, double *lng, double *lat) {
+    char buffer[128];
+    size_t len = (size_t)(end - line) < sizeof(buffer) - 1 ? (size_t)(end - line) : sizeof(buffer) - 1;
+    memcpy(buffer, line, len);
+    buffer[len] = '\0';
+    
+    char *next;
+    *lng = *lat = NAN;
+    double x = strtod(buffer, &next);
+    if(next == buffer) {
+        return;
+    }
+    char *p = next;
+    while(*p == ' ' || *p == '\t') {
+        ++p;
+    }
+    if(*p == ',' || *p == ';') {
+        ++p;
+    }
+    double y = strtod(p, &next);
+    if(next == p) {
+        return;
+    }
+    *lng = x;
+    *lat = y;
+}
+
+static int geo_data_cli_flush(geo_data *data, geo_data_cli_batch *batch) {
+    if(batch->num_points == 0) {
+        return 0;
+    }
+    geo_data_lookup_batch(data, batch->coords, batch->num_points, batch->results, batch->flags);
+    
+    char *out = batch->out;
+    for(unsigned int i = 0; i < batch->num_points; ++i) {
+        int v = batch->results[i];
+        if(v < 0) {
+            *out++ = '-';
+            *out++ = '1';
+        } else {
+            char digits[12];
+            int n = 0;
+            do {
+                digits[n++] = (char)('0' + v % 10);
+                v /= 10;
+            } while(v);
+            while(n) {
+                *out++ = digits[--n];
+            }
+        }
+        *out++ = '\n';
+    }
+    batch->num_points = 0;
+    size_t len = (size_t)(out - batch->out);
+    return fwrite(batch->out, 1, len, stdout) == len ? 0 : -1;
+}
+
+int main(int argc, char **argv) {
+    geo_data_options options;
+    geo_data_options_init(&options);
+    unsigned int max_points = GEO_DATA_CLI_POINTS, flags = 0;
+    int opt;
+    while((opt = getopt(argc, argv, "qrsn:h")) != -1) {
+        switch(opt) {
+            case 'q':
+                options.quadtree = 1;
+                break;
+            case 'r':
+                options.robust = 1;
+                break;
+            case 's':
+                flags |= GEO_DATA_BATCH_SPATIAL_ORDER;
+                break;
+            case 'n':
+                max_points = (unsigned int)strtoul(optarg, NULL, 10);
+                break;
+            default:
+                geo_data_cli_usage();
+                return 1;
+        }
+    }
+    if(optind >= argc || argc - optind > 2 || max_points == 0 || max_points > (1u << 26)) {
+        geo_data_cli_usage();
+        return 1;
+    }
+    
+    int status = 0;
+    geo_data *data = geo_data_create_with_options(argv[optind], &options, &status);
+    if(!data) {
+        fprintf(stderr, "geodata-classify: can't load %s (%d)\n", argv[optind], status);
+        return 2;
+    }
+    FILE *input = argc - optind == 2 ? fopen(argv[optind + 1], "r") : stdin;
+    if(!input) {
+        fprintf(stderr, "geodata-classify: can't open %s: %s\n", argv[optind + 1], strerror(errno));
+        geo_data_destroy(data);
+        return 2;
+    }
+    
+    geo_data_cli_batch batch;
+    batch.coords = (double *)malloc(sizeof(double) * 2 * max_points);
+    batch.results = (int *)malloc(sizeof(int) * max_points);
+    batch.out = (char *)malloc((size_t)12 * max_points);
+    batch.num_points = 0;
+    batch.max_points = max_points;
+    batch.flags = flags;
+    // room for one chunk plus the unfinished line carried over from the last one
+    size_t cap = GEO_DATA_CLI_READ * 2;
+    char *buffer = (char *)malloc(cap);
+    int failed = !batch.coords || !batch.results || !batch.out || !buffer;
+    
+    size_t len = 0;
+    while(!failed) {
+        size_t read = fread(buffer + len, 1, cap - len, input);
+        len += read;
+        int eof = read == 0;
+        if(eof && len && buffer[len - 1] != '\n') {
+            // a last line without newline
+            buffer[len++] = '\n';
+        }
+        
+        char *line = buffer, *end = buffer + len;
+        char *newline;
+        while((newline = (char *)memchr(line, '\n', end - line))) {
+            char *stop = newline > line && newline[-1] == '\r' ? newline - 1 : newline;
+            geo_data_cli_parse(line, stop, &batch.coords[batch.num_points * 2], &batch.coords[batch.num_points * 2 + 1]);
+            if(++batch.num_points == batch.max_points && geo_data_cli_flush(data, &batch)) {
+                failed = 1;
+                break;
+            }
+            line = newline + 1;
+        }
+        len = end - line;
+        memmove(buffer, line, len);
+        if(eof) {
+            break;
+        }
+        if(len == cap) {
+            // a single line longer than the buffer, it can't be a record
+            len = 0;
+            batch.coords[batch.num_points * 2] = batch.coords[batch.num_points * 2 + 1] = NAN;
+            while((read = fread(buffer, 1, cap, input)) && !memchr(buffer, '\n', read)) {
+            }
+            char *rest = read ? (char *)memchr(buffer, '\n', read) + 1 : buffer;
+            len = read ? buffer + read - rest : 0;
+            memmove(buffer, rest, len);
+            if(++batch.num_points == batch.max_points && geo_data_cli_flush(data, &batch)) {
+                failed = 1;
+            }
+        }
+    }
+    if(!failed && (geo_data_cli_flush(data, &batch) || fflush(stdout))) {
+        failed = 1;
+    }
+    if(ferror(input)) {
+        fprintf(stderr, "geodata-classify: read error: %s\n", strerror(errno));
+        failed = 1;
+    } else if(failed) {
+        fprintf(stderr, "geodata-classify: %s\n", buffer ? strerror(errno) : "out of memory");
+    }
+    
+    if(input != stdin) {
+        fclose(input);
+    }
+    free(buffer);
+    free(batch.coords);
+    free(batch.results);
+    free(batch.out);
+    geo_data_destroy(data);
+    return failed ? 3 : 0;
+}
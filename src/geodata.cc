@@ -1,189 +1,15 @@
+// node bindings for the C core in geodata_core.cc, everything below only goes through the API in geodata.h
 #include <node.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <errno.h>
 #include <string.h>
 
-// GEODATA FILE FORMAT:
-//
-// this is a custom file format specifically for low memory high performance hit tests on a set of polygons
-//
-// FILE LAYOUT
-// unsigned char header[4] = "GEO!"
-// unsigned int num_polygons = <number of polygons that follow>
-// <POLYGON DATA>
-//
-// POLYGON LAYOUT
-// unsigned int num_coordinates = <number of coordinates that follow>
-// <COORDINATE DATA>
-//
-// COORDINATE LAYOUT
-// double longitude
-// double latitude
-//
+#include "geodata.h"
 
 using namespace v8;
 
-// C IMPL
-
-typedef struct {
-    double lng;
-    double lat;
-} geo_data_coordinate;
-typedef struct {
-    unsigned int num_polygons;
-    uint8_t *polygons;
-} geo_data;
-
-
-int geo_data_hit_test(geo_data *data, double lng, double lat);
-int geo_data_hit_test(geo_data *data, double lng, double lat) {
-    if(!data) {
-        return 0;
-    }
-    uint8_t *polygon_ptr = data->polygons;
-    for(unsigned int n = 0; n < data->num_polygons; ++n) {
-        unsigned int num_coordinates = *(unsigned int *)polygon_ptr; polygon_ptr += sizeof(unsigned int);
-        geo_data_coordinate *coordinates = (geo_data_coordinate *)polygon_ptr;
-        
-        int c = 0;
-        int i = -1;
-        int l = num_coordinates;
-        int j = l - 1;
-        while(++i < l) {
-            if(((coordinates[i].lng <= lng && lng < coordinates[j].lng) ||
-                (coordinates[j].lng <= lng && lng < coordinates[i].lng)) &&
-               (lat < (coordinates[j].lat - coordinates[i].lat) * (lng - coordinates[i].lng) / (coordinates[j].lng - coordinates[i].lng) + coordinates[i].lat)) {
-                c = !c;
-            }
-            j = i;
-        }
-        
-        if(c) {
-            return 1;
-        }
-        
-        polygon_ptr += num_coordinates * sizeof(geo_data_coordinate);
-    }
-    return 0;
-};
-
-void geo_data_destroy(geo_data *data);
-void geo_data_destroy(geo_data *data) {
-    if(data) {
-        free(data->polygons);
-        free(data);
-    }
-}
-
-geo_data* geo_data_create(const char *filepath, int *status);
-geo_data* geo_data_create(const char *filepath, int *status) {
-    if(filepath == NULL || strlen(filepath) == 0) {
-        if(status) *status = -999;
-        return NULL;
-    }
-    
-    FILE *handle = fopen(filepath, "r");
-    if(handle == NULL) {
-        if(status) *status = -1000;
-        return NULL;
-    }
-    
-    if(fseek(handle, 0, SEEK_END)) {
-        fclose(handle);
-        if(status) *status = -1001;
-        return NULL;
-    }
-    unsigned int len = (unsigned int)ftell(handle);
-    if(fseek(handle, 0, SEEK_SET)) {
-        fclose(handle);
-        if(status) *status = -1002;
-        return NULL;
-    }
-    
-    if(len < sizeof(unsigned char) * 4 + sizeof(unsigned int)) {
-        fclose(handle);
-        if(status) *status = -1003;
-        return NULL;
-    }
-    
-    // verify header
-    unsigned char header[4];
-    if(!fread(header, 1, sizeof(unsigned char) * 4, handle)) {
-        fclose(handle);
-        if(status) *status = -1004;
-        return NULL;
-    }
-    if(header[0] != 'G' || header[1] != 'E' || header[2] != 'O' || header[3] != '!') {
-        fclose(handle);
-        if(status) *status = -1005;
-        return NULL;
-    }
-    
-    // get num polygons
-    unsigned int num_polygons = 0;
-    if(!fread(&num_polygons, 1, sizeof(unsigned int), handle)) {
-        fclose(handle);
-        if(status) *status = -1006;
-        return NULL;
-    }
-    
-    // create geodata
-    geo_data *data = (geo_data *)malloc(sizeof(geo_data));
-    data->num_polygons = num_polygons;
-    
-    // no polygons
-    if(data->num_polygons == 0) {
-        fclose(handle);
-        return data;
-    }
-    
-    // allocate buffer
-    unsigned int buffer_len = len - (sizeof(unsigned char) * 4 + sizeof(unsigned int));
-    void *buffer = malloc(buffer_len);
-    if(!buffer) {
-        fclose(handle);
-        if(status) *status = -1007;
-        return NULL;
-    }
-    
-    // assign buffer
-    data->polygons = (uint8_t *)buffer;
-    
-    // read remaining data
-    if(!fread(data->polygons, 1, buffer_len, handle)) {
-        geo_data_destroy(data);
-        fclose(handle);
-        if(status) *status = -1008;
-        return NULL;
-    }
-    
-    // verify data
-    unsigned int offset = 0;
-    uint8_t *polygon_ptr = data->polygons;
-    for(unsigned int i = 0; i < data->num_polygons; ++i) {
-        unsigned int polygon_len = sizeof(unsigned int);
-        
-        // get num_coordinates
-        if(offset + polygon_len > buffer_len) {
-            geo_data_destroy(data);
-            if(status) *status = -1009;
-            return NULL;
-        }
-        unsigned int num_coordinates = *(unsigned int *)polygon_ptr;
-        polygon_len += num_coordinates * sizeof(double) * 2;
-        if(offset + polygon_len > buffer_len) {
-            geo_data_destroy(data);
-            if(status) *status = -1010;
-            return NULL;
-        }
-        offset += polygon_len;
-        polygon_ptr += polygon_len;
-    }
-    
-    return data;
-};
-
 // C++ HORRIBLENESS
 
 // HELPERS
@@ -198,106 +24,283 @@ static inline char *TO_CHAR(Handle<Value> val) {
     return str;
 }
 
+// returns the backing store of a typed array of the given type or NULL
+static inline void *TO_TYPED_ARRAY(Handle<Value> val, ExternalArrayType type, unsigned int *length) {
+    if(!val->IsObject()) {
+        return NULL;
+    }
+    Local<Object> obj = val->ToObject();
+    if(!obj->HasIndexedPropertiesInExternalArrayData() || obj->GetIndexedPropertiesExternalArrayDataType() != type) {
+        return NULL;
+    }
+    if(length) *length = (unsigned int)obj->GetIndexedPropertiesExternalArrayDataLength();
+    return obj->GetIndexedPropertiesExternalArrayData();
+}
+
+// constructs a typed array through the global constructor, i.e. NEW_TYPED_ARRAY("Int32Array", 10)
+static inline Local<Object> NEW_TYPED_ARRAY(const char *type, unsigned int length) {
+    Local<Function> ctor = Local<Function>::Cast(Context::GetCurrent()->Global()->Get(String::NewSymbol(type)));
+    Handle<Value> argv[1] = {Integer::NewFromUnsigned(length)};
+    return ctor->NewInstance(1, argv);
+}
+
+// copies query results into a new Uint32Array and frees them
+static Local<Object> QUERY_RESULT(unsigned int *results, unsigned int num_results) {
+    Local<Object> array = NEW_TYPED_ARRAY("Uint32Array", num_results);
+    if(num_results) {
+        memcpy(array->GetIndexedPropertiesExternalArrayData(), results, sizeof(unsigned int) * num_results);
+    }
+    free(results);
+    return array;
+}
+
+// message for a negative geo_data_open status
+static const char *STATUS_MESSAGE(int status) {
+    switch(status) {
+        case -999:
+            return "Missing filepath";
+        case -1000:
+            return strerror(errno);
+        case -1001:
+            return "-1001";
+        case -1002:
+            return "-1002";
+        case -1003:
+            return "-1003";
+        case -1004:
+            return "-1004";
+        case -1005:
+            return "-1005";
+        case -1006:
+            return "-1006";
+        case -1007:
+            return "-1007";
+        case -1008:
+            return "-1008";
+        case -1009:
+            return "-1009";
+        case -1010:
+            return "-1010";
+        case -1011:
+            return "-1011";
+        case -1012:
+            return strerror(errno);
+        case -1013:
+            return "-1013";
+        case -1014:
+            return "-1014";
+        case -1015:
+            return "-1015";
+        case -1016:
+            return "-1016";
+        default:
+            return "Unknown";
+    }
+}
+
+// reads every option but shared, domain points into *domain when given
+static void TO_OPTIONS(Local<Object> opts, geo_data_options *options, geo_data_box *domain_box) {
+    options->huge_pages = opts->Get(String::NewSymbol("hugePages"))->BooleanValue();
+    options->numa = opts->Get(String::NewSymbol("numa"))->BooleanValue();
+    // quadtree: true or {depth, edges, memory}
+    Local<Value> quadtree = opts->Get(String::NewSymbol("quadtree"));
+    options->quadtree = quadtree->BooleanValue();
+    if(quadtree->IsObject()) {
+        Local<Object> quad = quadtree->ToObject();
+        options->quad_depth = quad->Get(String::NewSymbol("depth"))->Uint32Value();
+        options->quad_edges = quad->Get(String::NewSymbol("edges"))->Uint32Value();
+        Local<Value> memory = quad->Get(String::NewSymbol("memory"));
+        options->quad_memory = memory->IsNumber() && memory->NumberValue() > 0 ? (size_t)memory->NumberValue() : 0;
+    }
+    options->robust = opts->Get(String::NewSymbol("robust"))->BooleanValue();
+    // domain: [minLng, minLat, maxLng, maxLat], lookups outside it return -1 without touching the index
+    Local<Value> domain = opts->Get(String::NewSymbol("domain"));
+    if(domain->IsArray()) {
+        Local<Object> bounds = domain->ToObject();
+        domain_box->min_lng = bounds->Get(0)->NumberValue();
+        domain_box->min_lat = bounds->Get(1)->NumberValue();
+        domain_box->max_lng = bounds->Get(2)->NumberValue();
+        domain_box->max_lat = bounds->Get(3)->NumberValue();
+        options->domain = domain_box;
+    }
+}
+
 // HEADER
 
 class GeoData : public node::ObjectWrap {
 public:
     static void Init(Handle<Object> exports, Handle<Object> module);
 private:
-    explicit GeoData(const char *filepath);
+    explicit GeoData(const char *filepath, const geo_data_options *options);
+    explicit GeoData(geo_data *data);
     ~GeoData();
     
     static Handle<Value> New(const Arguments& args);
+    static Handle<Value> FromHandle(const Arguments& args);
+    static Handle<Value> GetHandle(const Arguments& args);
+    static Handle<Value> Stats(const Arguments& args);
     static Handle<Value> Contains(const Arguments& args);
+    static Handle<Value> Lookup(const Arguments& args);
+    static Handle<Value> ClassifyTrack(const Arguments& args);
+    static Handle<Value> LookupBatch(const Arguments& args);
+    static Handle<Value> DistanceToBoundary(const Arguments& args);
+    static Handle<Value> Nearest(const Arguments& args);
+    static Handle<Value> QueryBox(const Arguments& args);
+    static Handle<Value> QueryRadius(const Arguments& args);
+    static Handle<Value> Intersects(const Arguments& args);
+    static Handle<Value> Within(const Arguments& args);
+    static Handle<Value> QueryRing(const Arguments& args, int mode);
+    static Handle<Value> LookupPath(const Arguments& args);
+    static Handle<Value> LookupProps(const Arguments& args);
+    static Handle<Value> Properties(const Arguments& args);
+    static Local<Object> PropsObject(geo_data *data, unsigned int n, Handle<Value> names);
     static Persistent<Function> constructor;
     geo_data *geo_data_;
+    friend class GeoDataLayers;
+};
+
+class GeoDataLayers : public node::ObjectWrap {
+public:
+    static Handle<Function> Init();
+private:
+    explicit GeoDataLayers(geo_data_layers *layers);
+    ~GeoDataLayers();
+    
+    static Handle<Value> New(const Arguments& args);
+    static Handle<Value> LookupAll(const Arguments& args);
+    static Handle<Value> Layer(const Arguments& args);
+    static Persistent<Function> constructor;
+    geo_data_layers *layers_;
 };
 
 // IMPL
 
-Persistent<Function> GeoData::constructor;
-GeoData::GeoData(const char *filepath) {
-    if(filepath != NULL) {
+Persistent<Function> GeoData::constructor; // one isolate only, see FromHandle
+GeoData::GeoData(const char *filepath, const geo_data_options *options) {
+    if(filepath != NULL || options->shared_name != NULL) {
         int status = 0;
-        this->geo_data_ = geo_data_create(filepath, &status);
+        this->geo_data_ = geo_data_open(filepath, options, &status);
         
         if(status < 0) {
-            const char *msg = NULL;
-            switch(status) {
-                case -999:
-                    msg = "Missing filepath";
-                    break;
-                case -1000:
-                    msg = strerror(errno);
-                    break;
-                case -1001:
-                    msg = "-1001";
-                    break;
-                case -1002:
-                    msg = "-1002";
-                    break;
-                case -1003:
-                    msg = "-1003";
-                    break;
-                case -1004:
-                    msg = "-1004";
-                    break;
-                case -1005:
-                    msg = "-1005";
-                    break;
-                case -1006:
-                    msg = "-1006";
-                    break;
-                case -1007:
-                    msg = "-1007";
-                    break;
-                case -1008:
-                    msg = "-1008";
-                    break;
-                case -1009:
-                    msg = "-1009";
-                    break;
-                case -1010:
-                    msg = "-1010";
-                    break;
-                default:
-                    msg = "Unknown";
-                    break;
-            }
-            ThrowException(Exception::TypeError(String::New(msg)));
+            ThrowException(Exception::TypeError(String::New(STATUS_MESSAGE(status))));
         }
         
     } else {
         this->geo_data_ = NULL;
     }
 }
+GeoData::GeoData(geo_data *data) {
+    this->geo_data_ = data;
+}
 GeoData::~GeoData() {
     if(this->geo_data_) {
-        geo_data_destroy(this->geo_data_);
+        geo_data_release(this->geo_data_);
     }
 }
 
 Handle<Value> GeoData::New(const Arguments& args) {
     HandleScope scope;
     if(args.IsConstructCall()) {
-        char *filepath = TO_CHAR(args[0]);
-        GeoData *obj = new GeoData((const char *)filepath);
+        // FromHandle passes an already retained dataset
+        if(args[0]->IsExternal()) {
+            GeoData *obj = new GeoData((geo_data *)External::Unwrap(args[0]));
+            obj->Wrap(args.This());
+            return args.This();
+        }
+        // new GeoData(filepath[, {shared: name}]), the filepath can be null to attach to an existing segment
+        geo_data_options options;
+        geo_data_options_init(&options);
+        char *shared_name = NULL;
+        geo_data_box domain_box;
+        if(args[1]->IsObject()) {
+            Local<Object> opts = args[1]->ToObject();
+            Local<Value> shared = opts->Get(String::NewSymbol("shared"));
+            if(shared->IsString()) {
+                shared_name = TO_CHAR(shared);
+                options.shared_name = shared_name;
+            }
+            TO_OPTIONS(opts, &options, &domain_box);
+        }
+        char *filepath = shared_name && (args[0]->IsNull() || args[0]->IsUndefined()) ? NULL : TO_CHAR(args[0]);
+        GeoData *obj = new GeoData((const char *)filepath, &options);
         free(filepath);
+        free(shared_name);
         obj->Wrap(args.This());
         return args.This();
     } else {
-        const int argc = 1;
-        Local<Value> argv[argc] = {args[0]};
+        const int argc = 2;
+        Local<Value> argv[argc] = {args[0], args[1]};
         return scope.Close(constructor->NewInstance(argc, argv));
     }
 }
+// wraps the dataset behind a handle from GetHandle. the module targets the node 0.10 API and isn't context aware, so
+// it loads in the main isolate only and handles can't be re-wrapped in worker threads. the registry behind them is
+// process wide, native threads share datasets through geo_data_from_id
+Handle<Value> GeoData::FromHandle(const Arguments& args) {
+    HandleScope scope;
+    
+    geo_data *data = args[0]->IsNumber() ? geo_data_from_id(args[0]->Uint32Value()) : NULL;
+    if(!data) {
+        ThrowException(Exception::Error(String::New("Unknown or released GeoData handle")));
+        return scope.Close(Undefined());
+    }
+    
+    const int argc = 1;
+    Handle<Value> argv[argc] = {External::Wrap(data)};
+    return scope.Close(constructor->NewInstance(argc, argv));
+}
+Handle<Value> GeoData::GetHandle(const Arguments& args) {
+    HandleScope scope;
+    
+    GeoData *obj = node::ObjectWrap::Unwrap<GeoData>(args.This());
+    if(!obj->geo_data_) {
+        return scope.Close(Undefined());
+    }
+    
+    return scope.Close(Integer::NewFromUnsigned(geo_data_id(obj->geo_data_)));
+}
+Handle<Value> GeoData::Stats(const Arguments& args) {
+    HandleScope scope;
+    
+    GeoData *obj = node::ObjectWrap::Unwrap<GeoData>(args.This());
+    
+    geo_data_stats stats;
+    geo_data_get_stats(obj->geo_data_, &stats);
+    
+    const char *storage = "heap";
+    switch(stats.storage) {
+        case GEO_DATA_STORAGE_SHARED:
+            storage = "shared";
+            break;
+        case GEO_DATA_STORAGE_HUGETLB:
+            storage = "hugetlb";
+            break;
+        case GEO_DATA_STORAGE_THP:
+            storage = "thp";
+            break;
+        case GEO_DATA_STORAGE_ANONYMOUS:
+            storage = "anonymous";
+            break;
+    }
+    
+    Local<Object> result = Object::New();
+    result->Set(String::NewSymbol("polygons"), Integer::NewFromUnsigned(stats.num_polygons));
+    result->Set(String::NewSymbol("invalidPolygons"), Integer::NewFromUnsigned(stats.num_invalid));
+    result->Set(String::NewSymbol("memory"), Number::New((double)stats.memory));
+    result->Set(String::NewSymbol("storage"), String::New(storage));
+    result->Set(String::NewSymbol("hugePageMemory"), Number::New((double)stats.huge_bytes));
+    result->Set(String::NewSymbol("replicas"), Integer::NewFromUnsigned(stats.num_replicas));
+    result->Set(String::NewSymbol("quadNodes"), Integer::NewFromUnsigned(stats.quad_nodes));
+    result->Set(String::NewSymbol("quadMemory"), Number::New((double)stats.quad_memory));
+    return scope.Close(result);
+}
 Handle<Value> GeoData::Contains(const Arguments& args) {
     HandleScope scope;
     
     double lng = args[0]->IsUndefined() ? -320.0 : args[0]->NumberValue();
     double lat = args[1]->IsUndefined() ? -320.0 : args[1]->NumberValue();
     
-    if(lng < -180.0 || lng > 180.0 || lat < -180.0 || lat > 180.0) {
+    if(lng < -180.0 || lng > 180.0 || lat < -90.0 || lat > 90.0) {
         return scope.Close(Boolean::New(false));
     }
     
@@ -310,6 +313,318 @@ Handle<Value> GeoData::Contains(const Arguments& args) {
     }
 }
 
+Handle<Value> GeoData::Lookup(const Arguments& args) {
+    HandleScope scope;
+    
+    double lng = args[0]->IsUndefined() ? -320.0 : args[0]->NumberValue();
+    double lat = args[1]->IsUndefined() ? -320.0 : args[1]->NumberValue();
+    
+    if(lng < -180.0 || lng > 180.0 || lat < -90.0 || lat > 90.0) {
+        return scope.Close(Integer::New(-1));
+    }
+    
+    GeoData *obj = node::ObjectWrap::Unwrap<GeoData>(args.This());
+    
+    return scope.Close(Integer::New(geo_data_lookup(obj->geo_data_, lng, lat)));
+}
+Handle<Value> GeoData::ClassifyTrack(const Arguments& args) {
+    HandleScope scope;
+    
+    unsigned int length = 0;
+    double *coords = (double *)TO_TYPED_ARRAY(args[0], kExternalDoubleArray, &length);
+    if(!coords) {
+        ThrowException(Exception::TypeError(String::New("Expected a Float64Array of lng/lat pairs")));
+        return scope.Close(Undefined());
+    }
+    
+    GeoData *obj = node::ObjectWrap::Unwrap<GeoData>(args.This());
+    
+    unsigned int num_points = length / 2;
+    unsigned int *indices = (unsigned int *)malloc(sizeof(unsigned int) * (num_points ? num_points : 1));
+    int *polygons = (int *)malloc(sizeof(int) * (num_points ? num_points : 1));
+    if(!indices || !polygons) {
+        free(indices);
+        free(polygons);
+        ThrowException(Exception::Error(String::New("Out of memory")));
+        return scope.Close(Undefined());
+    }
+    
+    unsigned int count = geo_data_classify_track(obj->geo_data_, coords, num_points, indices, polygons);
+    
+    // interleaved point index / polygon index pairs
+    Local<Object> result = NEW_TYPED_ARRAY("Int32Array", count * 2);
+    int *transitions = (int *)result->GetIndexedPropertiesExternalArrayData();
+    for(unsigned int i = 0; i < count; ++i) {
+        transitions[i * 2] = (int)indices[i];
+        transitions[i * 2 + 1] = polygons[i];
+    }
+    free(indices);
+    free(polygons);
+    
+    return scope.Close(result);
+}
+
+Handle<Value> GeoData::LookupBatch(const Arguments& args) {
+    HandleScope scope;
+    
+    unsigned int length = 0;
+    double *coords = (double *)TO_TYPED_ARRAY(args[0], kExternalDoubleArray, &length);
+    if(!coords) {
+        ThrowException(Exception::TypeError(String::New("Expected a Float64Array of lng/lat pairs")));
+        return scope.Close(Undefined());
+    }
+    unsigned int num_points = length / 2;
+    
+    // results are written in place when an Int32Array is passed
+    Local<Object> result;
+    if(args[1]->IsUndefined() || args[1]->IsNull()) {
+        result = NEW_TYPED_ARRAY("Int32Array", num_points);
+    } else {
+        unsigned int result_length = 0;
+        if(!TO_TYPED_ARRAY(args[1], kExternalIntArray, &result_length) || result_length < num_points) {
+            ThrowException(Exception::TypeError(String::New("Expected an Int32Array with room for every point")));
+            return scope.Close(Undefined());
+        }
+        result = args[1]->ToObject();
+    }
+    int *results = (int *)result->GetIndexedPropertiesExternalArrayData();
+    
+    unsigned int flags = 0;
+    if(args[2]->IsObject()) {
+        Local<Object> options = args[2]->ToObject();
+        if(options->Get(String::NewSymbol("sort"))->BooleanValue()) {
+            flags |= GEO_DATA_BATCH_SPATIAL_ORDER;
+        }
+    }
+    
+    GeoData *obj = node::ObjectWrap::Unwrap<GeoData>(args.This());
+    
+    geo_data_lookup_batch(obj->geo_data_, coords, num_points, results, flags);
+    
+    return scope.Close(result);
+}
+
+// {distance, polygon, edge} of the nearest polygon edge, distance in meters, null without any polygon
+Handle<Value> GeoData::DistanceToBoundary(const Arguments& args) {
+    HandleScope scope;
+    
+    double lng = args[0]->IsUndefined() ? -320.0 : args[0]->NumberValue();
+    double lat = args[1]->IsUndefined() ? -320.0 : args[1]->NumberValue();
+    
+    if(lng < -180.0 || lng > 180.0 || lat < -90.0 || lat > 90.0) {
+        return scope.Close(Null());
+    }
+    
+    GeoData *obj = node::ObjectWrap::Unwrap<GeoData>(args.This());
+    
+    geo_data_distance distance;
+    geo_data_distance_to_boundary(obj->geo_data_, lng, lat, &distance);
+    if(distance.polygon < 0) {
+        return scope.Close(Null());
+    }
+    
+    Local<Object> result = Object::New();
+    result->Set(String::NewSymbol("distance"), Number::New(distance.meters));
+    result->Set(String::NewSymbol("polygon"), Integer::New(distance.polygon));
+    result->Set(String::NewSymbol("edge"), Integer::NewFromUnsigned(distance.edge));
+    return scope.Close(result);
+}
+
+// [{polygon, distance}, ...] for the k nearest polygons, closest first, distance in meters
+Handle<Value> GeoData::Nearest(const Arguments& args) {
+    HandleScope scope;
+    
+    double lng = args[0]->IsUndefined() ? -320.0 : args[0]->NumberValue();
+    double lat = args[1]->IsUndefined() ? -320.0 : args[1]->NumberValue();
+    unsigned int k = args[2]->IsUndefined() ? 1 : args[2]->Uint32Value();
+    
+    if(lng < -180.0 || lng > 180.0 || lat < -90.0 || lat > 90.0) {
+        return scope.Close(Array::New(0));
+    }
+    
+    GeoData *obj = node::ObjectWrap::Unwrap<GeoData>(args.This());
+    
+    geo_data_stats stats;
+    geo_data_get_stats(obj->geo_data_, &stats);
+    k = k < stats.num_polygons ? k : stats.num_polygons;
+    int *polygons = (int *)malloc(sizeof(int) * (k ? k : 1));
+    double *meters = (double *)malloc(sizeof(double) * (k ? k : 1));
+    int found = polygons && meters ? geo_data_nearest(obj->geo_data_, lng, lat, k, polygons, meters) : -1;
+    if(found < 0) {
+        free(polygons);
+        free(meters);
+        ThrowException(Exception::Error(String::New("Out of memory")));
+        return scope.Close(Undefined());
+    }
+    
+    Local<Array> result = Array::New(found);
+    for(int i = 0; i < found; ++i) {
+        Local<Object> entry = Object::New();
+        entry->Set(String::NewSymbol("polygon"), Integer::New(polygons[i]));
+        entry->Set(String::NewSymbol("distance"), Number::New(meters[i]));
+        result->Set(i, entry);
+    }
+    free(polygons);
+    free(meters);
+    return scope.Close(result);
+}
+
+// Uint32Array of the polygons intersecting the box, {exact: true} tests their edges instead of their boxes alone
+Handle<Value> GeoData::QueryBox(const Arguments& args) {
+    HandleScope scope;
+    
+    geo_data_box box;
+    box.min_lng = args[0]->NumberValue();
+    box.min_lat = args[1]->NumberValue();
+    box.max_lng = args[2]->NumberValue();
+    box.max_lat = args[3]->NumberValue();
+    int exact = args[4]->IsObject() && args[4]->ToObject()->Get(String::NewSymbol("exact"))->BooleanValue();
+    
+    GeoData *obj = node::ObjectWrap::Unwrap<GeoData>(args.This());
+    
+    unsigned int *results, num_results;
+    if(geo_data_query_box(obj->geo_data_, &box, exact, &results, &num_results)) {
+        ThrowException(Exception::Error(String::New("Out of memory")));
+        return scope.Close(Undefined());
+    }
+    return scope.Close(QUERY_RESULT(results, num_results));
+}
+
+// Uint32Array of the polygons within meters of the point, {exact: true} measures to their edges instead of their boxes
+Handle<Value> GeoData::QueryRadius(const Arguments& args) {
+    HandleScope scope;
+    
+    double lng = args[0]->IsUndefined() ? -320.0 : args[0]->NumberValue();
+    double lat = args[1]->IsUndefined() ? -320.0 : args[1]->NumberValue();
+    double meters = args[2]->NumberValue();
+    int exact = args[3]->IsObject() && args[3]->ToObject()->Get(String::NewSymbol("exact"))->BooleanValue();
+    
+    if(lng < -180.0 || lng > 180.0 || lat < -90.0 || lat > 90.0) {
+        return scope.Close(NEW_TYPED_ARRAY("Uint32Array", 0));
+    }
+    
+    GeoData *obj = node::ObjectWrap::Unwrap<GeoData>(args.This());
+    
+    unsigned int *results, num_results;
+    if(geo_data_query_radius(obj->geo_data_, lng, lat, meters, exact, &results, &num_results)) {
+        ThrowException(Exception::Error(String::New("Out of memory")));
+        return scope.Close(Undefined());
+    }
+    return scope.Close(QUERY_RESULT(results, num_results));
+}
+
+Handle<Value> GeoData::QueryRing(const Arguments& args, int mode) {
+    HandleScope scope;
+    
+    unsigned int length = 0;
+    double *coords = (double *)TO_TYPED_ARRAY(args[0], kExternalDoubleArray, &length);
+    if(!coords) {
+        ThrowException(Exception::TypeError(String::New("Expected a Float64Array of lng/lat pairs")));
+        return scope.Close(Undefined());
+    }
+    
+    GeoData *obj = node::ObjectWrap::Unwrap<GeoData>(args.This());
+    
+    unsigned int *results, num_results;
+    if(geo_data_query_ring(obj->geo_data_, coords, length / 2, mode, &results, &num_results)) {
+        ThrowException(Exception::Error(String::New("Out of memory")));
+        return scope.Close(Undefined());
+    }
+    return scope.Close(QUERY_RESULT(results, num_results));
+}
+
+// Uint32Array of the polygons sharing any point with the ring
+Handle<Value> GeoData::Intersects(const Arguments& args) {
+    return QueryRing(args, GEO_DATA_RING_INTERSECTS);
+}
+
+// Uint32Array of the polygons the ring lies within without touching their boundary
+Handle<Value> GeoData::Within(const Arguments& args) {
+    return QueryRing(args, GEO_DATA_RING_WITHIN);
+}
+
+// the polygon's properties, the columns named in the names array or every column without one. unknown names are
+// skipped, int64 values become numbers and lose precision beyond 2^53
+Local<Object> GeoData::PropsObject(geo_data *data, unsigned int n, Handle<Value> names) {
+    Local<Object> result = Object::New();
+    unsigned int num_names = geo_data_prop_count(data);
+    Local<Array> list;
+    if(names->IsArray()) {
+        list = Local<Array>::Cast(names);
+        num_names = list->Length();
+    }
+    for(unsigned int i = 0; i < num_names; ++i) {
+        int column = (int)i;
+        if(!list.IsEmpty()) {
+            String::Utf8Value name(list->Get(i)->ToString());
+            column = geo_data_prop_find(data, *name);
+        }
+        if(column < 0) {
+            continue;
+        }
+        Local<String> key = String::New(geo_data_prop_name(data, column));
+        int64_t value;
+        unsigned int len;
+        const char *str;
+        if(geo_data_prop_int64(data, column, n, &value) == 0) {
+            result->Set(key, Number::New((double)value));
+        } else if((str = geo_data_prop_string(data, column, n, &len))) {
+            result->Set(key, String::New(str, len));
+        }
+    }
+    return result;
+}
+
+#define GEO_DATA_PATH_MAX 64
+
+// Int32Array of the nested polygons containing the point, outermost first, through the file's hierarchy. the deepest
+// GEO_DATA_PATH_MAX levels are plenty for administrative boundaries
+Handle<Value> GeoData::LookupPath(const Arguments& args) {
+    HandleScope scope;
+    
+    double lng = args[0]->IsUndefined() ? -320.0 : args[0]->NumberValue();
+    double lat = args[1]->IsUndefined() ? -320.0 : args[1]->NumberValue();
+    
+    GeoData *obj = node::ObjectWrap::Unwrap<GeoData>(args.This());
+    
+    int path[GEO_DATA_PATH_MAX];
+    unsigned int depth = geo_data_lookup_path(obj->geo_data_, lng, lat, path, GEO_DATA_PATH_MAX);
+    Local<Object> result = NEW_TYPED_ARRAY("Int32Array", depth);
+    if(depth) {
+        memcpy(result->GetIndexedPropertiesExternalArrayData(), path, sizeof(int) * depth);
+    }
+    return scope.Close(result);
+}
+
+// properties of the polygon containing the point, null when none does, see PropsObject
+Handle<Value> GeoData::LookupProps(const Arguments& args) {
+    HandleScope scope;
+    
+    double lng = args[0]->IsUndefined() ? -320.0 : args[0]->NumberValue();
+    double lat = args[1]->IsUndefined() ? -320.0 : args[1]->NumberValue();
+    
+    GeoData *obj = node::ObjectWrap::Unwrap<GeoData>(args.This());
+    
+    int n = geo_data_lookup(obj->geo_data_, lng, lat);
+    if(n < 0) {
+        return scope.Close(Null());
+    }
+    return scope.Close(PropsObject(obj->geo_data_, (unsigned int)n, args[2]));
+}
+
+// properties of a polygon by index, i.e. from lookupBatch, null for an unknown index
+Handle<Value> GeoData::Properties(const Arguments& args) {
+    HandleScope scope;
+    
+    GeoData *obj = node::ObjectWrap::Unwrap<GeoData>(args.This());
+    
+    double n = args[0]->NumberValue();
+    if(!obj->geo_data_ || !(n >= 0.0) || n >= geo_data_num_polygons(obj->geo_data_)) {
+        return scope.Close(Null());
+    }
+    return scope.Close(PropsObject(obj->geo_data_, (unsigned int)n, args[1]));
+}
+
 void GeoData::Init(Handle<Object> exports, Handle<Object> module) {
     // template
     Local<FunctionTemplate> tpl = FunctionTemplate::New(New);
@@ -319,12 +634,177 @@ void GeoData::Init(Handle<Object> exports, Handle<Object> module) {
     // prototype
     tpl->PrototypeTemplate()->Set(String::NewSymbol("contains"),
                                   FunctionTemplate::New(Contains)->GetFunction());
+    tpl->PrototypeTemplate()->Set(String::NewSymbol("lookup"),
+                                  FunctionTemplate::New(Lookup)->GetFunction());
+    tpl->PrototypeTemplate()->Set(String::NewSymbol("classifyTrack"),
+                                  FunctionTemplate::New(ClassifyTrack)->GetFunction());
+    tpl->PrototypeTemplate()->Set(String::NewSymbol("lookupBatch"),
+                                  FunctionTemplate::New(LookupBatch)->GetFunction());
+    tpl->PrototypeTemplate()->Set(String::NewSymbol("distanceToBoundary"),
+                                  FunctionTemplate::New(DistanceToBoundary)->GetFunction());
+    tpl->PrototypeTemplate()->Set(String::NewSymbol("nearest"),
+                                  FunctionTemplate::New(Nearest)->GetFunction());
+    tpl->PrototypeTemplate()->Set(String::NewSymbol("queryBox"),
+                                  FunctionTemplate::New(QueryBox)->GetFunction());
+    tpl->PrototypeTemplate()->Set(String::NewSymbol("queryRadius"),
+                                  FunctionTemplate::New(QueryRadius)->GetFunction());
+    tpl->PrototypeTemplate()->Set(String::NewSymbol("intersects"),
+                                  FunctionTemplate::New(Intersects)->GetFunction());
+    tpl->PrototypeTemplate()->Set(String::NewSymbol("within"),
+                                  FunctionTemplate::New(Within)->GetFunction());
+    tpl->PrototypeTemplate()->Set(String::NewSymbol("lookupPath"),
+                                  FunctionTemplate::New(LookupPath)->GetFunction());
+    tpl->PrototypeTemplate()->Set(String::NewSymbol("lookupProps"),
+                                  FunctionTemplate::New(LookupProps)->GetFunction());
+    tpl->PrototypeTemplate()->Set(String::NewSymbol("properties"),
+                                  FunctionTemplate::New(Properties)->GetFunction());
+    tpl->PrototypeTemplate()->Set(String::NewSymbol("handle"),
+                                  FunctionTemplate::New(GetHandle)->GetFunction());
+    tpl->PrototypeTemplate()->Set(String::NewSymbol("stats"),
+                                  FunctionTemplate::New(Stats)->GetFunction());
     constructor = Persistent<Function>::New(tpl->GetFunction());
+    constructor->Set(String::NewSymbol("fromHandle"), FunctionTemplate::New(FromHandle)->GetFunction());
+    constructor->Set(String::NewSymbol("Layers"), GeoDataLayers::Init());
     
     // module
     module->Set(String::NewSymbol("exports"), constructor);
 }
 
+Persistent<Function> GeoDataLayers::constructor;
+GeoDataLayers::GeoDataLayers(geo_data_layers *layers) {
+    this->layers_ = layers;
+}
+GeoDataLayers::~GeoDataLayers() {
+    geo_data_layers_destroy(this->layers_);
+}
+
+// new GeoData.Layers({name: filepath, ...}[, options]), every layer is opened with the same options but shared
+Handle<Value> GeoDataLayers::New(const Arguments& args) {
+    HandleScope scope;
+    if(!args.IsConstructCall()) {
+        const int argc = 2;
+        Local<Value> argv[argc] = {args[0], args[1]};
+        return scope.Close(constructor->NewInstance(argc, argv));
+    }
+    if(!args[0]->IsObject()) {
+        ThrowException(Exception::TypeError(String::New("Expected an object of layer names to filepaths")));
+        return scope.Close(Undefined());
+    }
+    
+    geo_data_options options;
+    geo_data_options_init(&options);
+    geo_data_box domain_box;
+    if(args[1]->IsObject()) {
+        TO_OPTIONS(args[1]->ToObject(), &options, &domain_box);
+    }
+    
+    Local<Object> spec = args[0]->ToObject();
+    Local<Array> keys = spec->GetOwnPropertyNames();
+    unsigned int num_layers = keys->Length();
+    char **names = (char **)calloc(num_layers ? num_layers : 1, sizeof(char *));
+    char **filepaths = (char **)calloc(num_layers ? num_layers : 1, sizeof(char *));
+    geo_data_layers *layers = NULL;
+    int status = -1000;
+    unsigned int failed = 0;
+    if(names && filepaths) {
+        for(unsigned int i = 0; i < num_layers; ++i) {
+            names[i] = TO_CHAR(keys->Get(i));
+            filepaths[i] = TO_CHAR(spec->Get(keys->Get(i)));
+        }
+        layers = geo_data_layers_open((const char **)names, (const char **)filepaths, num_layers, &options, &status, &failed);
+    }
+    
+    if(!layers) {
+        char msg[256];
+        snprintf(msg, sizeof(msg), "%s: %s", names && failed < num_layers ? names[failed] : "layers", STATUS_MESSAGE(status));
+        ThrowException(Exception::TypeError(String::New(msg)));
+    }
+    for(unsigned int i = 0; i < num_layers && names && filepaths; ++i) {
+        free(names[i]);
+        free(filepaths[i]);
+    }
+    free(names);
+    free(filepaths);
+    if(!layers) {
+        return scope.Close(Undefined());
+    }
+    
+    GeoDataLayers *obj = new GeoDataLayers(layers);
+    obj->Wrap(args.This());
+    return args.This();
+}
+
+// {name: polygon index, ...} with -1 where no polygon contains the point. with an Int32Array of one entry per
+// layer the indices are written into it in layer order instead and it is returned
+Handle<Value> GeoDataLayers::LookupAll(const Arguments& args) {
+    HandleScope scope;
+    
+    double lng = args[0]->IsUndefined() ? -320.0 : args[0]->NumberValue();
+    double lat = args[1]->IsUndefined() ? -320.0 : args[1]->NumberValue();
+    
+    GeoDataLayers *obj = node::ObjectWrap::Unwrap<GeoDataLayers>(args.This());
+    geo_data_layers *layers = obj->layers_;
+    unsigned int num_layers = geo_data_layers_count(layers);
+    
+    unsigned int length = 0;
+    int *results = (int *)TO_TYPED_ARRAY(args[2], kExternalIntArray, &length);
+    if(results) {
+        if(length < num_layers) {
+            ThrowException(Exception::RangeError(String::New("results needs one entry per layer")));
+            return scope.Close(Undefined());
+        }
+        geo_data_lookup_all(layers, lng, lat, results);
+        return scope.Close(args[2]);
+    }
+    
+    int stack[16];
+    int *indices = num_layers <= 16 ? stack : (int *)malloc(sizeof(int) * num_layers);
+    if(!indices) {
+        ThrowException(Exception::Error(String::New("Out of memory")));
+        return scope.Close(Undefined());
+    }
+    geo_data_lookup_all(layers, lng, lat, indices);
+    Local<Object> result = Object::New();
+    for(unsigned int i = 0; i < num_layers; ++i) {
+        result->Set(String::New(geo_data_layers_name(layers, i)), Integer::New(indices[i]));
+    }
+    if(indices != stack) {
+        free(indices);
+    }
+    return scope.Close(result);
+}
+
+// GeoData sharing the named layer's dataset, undefined for an unknown name
+Handle<Value> GeoDataLayers::Layer(const Arguments& args) {
+    HandleScope scope;
+    
+    GeoDataLayers *obj = node::ObjectWrap::Unwrap<GeoDataLayers>(args.This());
+    geo_data_layers *layers = obj->layers_;
+    
+    String::Utf8Value name(args[0]->ToString());
+    for(unsigned int i = 0; i < geo_data_layers_count(layers); ++i) {
+        if(strcmp(geo_data_layers_name(layers, i), *name) == 0) {
+            const int argc = 1;
+            Handle<Value> argv[argc] = {External::Wrap(geo_data_retain(geo_data_layers_get(layers, i)))};
+            return scope.Close(GeoData::constructor->NewInstance(argc, argv));
+        }
+    }
+    return scope.Close(Undefined());
+}
+
+Handle<Function> GeoDataLayers::Init() {
+    Local<FunctionTemplate> tpl = FunctionTemplate::New(New);
+    tpl->SetClassName(String::NewSymbol("Layers"));
+    tpl->InstanceTemplate()->SetInternalFieldCount(1);
+    
+    tpl->PrototypeTemplate()->Set(String::NewSymbol("lookupAll"),
+                                  FunctionTemplate::New(LookupAll)->GetFunction());
+    tpl->PrototypeTemplate()->Set(String::NewSymbol("layer"),
+                                  FunctionTemplate::New(Layer)->GetFunction());
+    constructor = Persistent<Function>::New(tpl->GetFunction());
+    return constructor;
+}
+
 void Init(Handle<Object> exports, Handle<Object> module) {
     GeoData::Init(exports, module);
 }
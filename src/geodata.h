@@ -0,0 +1,141 @@
+// geodata C API
+//
+// the core behind the node module, built as the geodata_core static library so it can be linked and measured without
+// node. every function below is thread safe for concurrent lookups on the same dataset. datasets are opaque, create
+// them with geo_data_open and drop them with geo_data_release, or geo_data_create and geo_data_destroy for a private
+// copy that isn't shared process wide.
+//
+// GEO_DATA_VERSION_MAJOR changes whenever a declaration below changes incompatibly, GEO_DATA_VERSION_MINOR when
+// functions or options are added. geo_data_version returns the version the library was built from, compare it with
+// GEO_DATA_VERSION to catch a header and library mismatch.
+//
+// status codes are negative: -999 missing filepath, -1000 and -1012 system errors reported in errno, the others a
+// malformed file, index or shared segment
+
+#ifndef GEO_DATA_H
+#define GEO_DATA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define GEO_DATA_VERSION_MAJOR 1
+#define GEO_DATA_VERSION_MINOR 0
+#define GEO_DATA_VERSION (GEO_DATA_VERSION_MAJOR * 1000 + GEO_DATA_VERSION_MINOR)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct geo_data geo_data;
+typedef struct geo_data_layers geo_data_layers;
+
+typedef struct {
+    double min_lng;
+    double min_lat;
+    double max_lng;
+    double max_lat;
+} geo_data_box;
+
+typedef struct {
+    const char *shared_name; // POSIX shared memory segment holding the prepared dataset, NULL to keep it private
+    int huge_pages; // back private datasets with 2MB pages
+    int numa; // one copy of private datasets per NUMA node
+    int quadtree; // build the in/out quadtree, answers match the scan's including points on borders, see geo_data_quad_build
+    unsigned int quad_depth; // deepest level, 0 for GEO_DATA_QUAD_DEPTH
+    unsigned int quad_edges; // leaves with at most this many edges aren't split, 0 for GEO_DATA_QUAD_EDGES
+    size_t quad_memory; // cap in bytes, the tree is dropped when even the coarsest version exceeds it, 0 for GEO_DATA_QUAD_MEMORY
+    int robust; // exact predicates for points on or near an edge, see geo_data_orient_robust
+    const geo_data_box *domain; // only lookups within it can hit, min_lng above max_lng wraps, NULL for the whole world
+} geo_data_options;
+
+#define GEO_DATA_STORAGE_HEAP 0
+#define GEO_DATA_STORAGE_SHARED 1
+#define GEO_DATA_STORAGE_HUGETLB 2 // explicit 2MB pages
+#define GEO_DATA_STORAGE_THP 3 // 2MB aligned anonymous memory advised for transparent huge pages
+#define GEO_DATA_STORAGE_ANONYMOUS 4 // plain anonymous mapping, i.e. a NUMA replica
+
+typedef struct {
+    unsigned int num_polygons;
+    unsigned int num_invalid; // polygons excluded by validation
+    size_t memory; // bytes held by the polygons and their indexes
+    int storage; // GEO_DATA_STORAGE_*
+    size_t huge_bytes; // bytes the kernel reports as backed by huge pages
+    unsigned int num_replicas; // NUMA nodes holding a copy, 0 without replication
+    unsigned int quad_nodes; // 0 without a quadtree
+    size_t quad_memory;
+} geo_data_stats;
+
+typedef struct {
+    double meters; // HUGE_VAL without any valid polygon
+    int polygon; // -1 without any valid polygon
+    unsigned int edge; // runs from coordinate edge to edge + 1, wrapping around
+} geo_data_distance;
+
+#define GEO_DATA_RING_INTERSECTS 0 // polygons sharing any point with the ring
+#define GEO_DATA_RING_WITHIN 1 // polygons the ring lies strictly within, boundaries not touching
+
+#define GEO_DATA_BATCH_SPATIAL_ORDER 1 // visit the points in morton order
+
+// VERSION
+
+int geo_data_version(void);
+
+// LIFETIME
+
+void geo_data_options_init(geo_data_options *options);
+geo_data *geo_data_create(const char *filepath, int *status);
+geo_data *geo_data_create_with_options(const char *filepath, const geo_data_options *options, int *status);
+void geo_data_destroy(geo_data *data);
+geo_data *geo_data_open(const char *filepath, const geo_data_options *options, int *status);
+geo_data *geo_data_retain(geo_data *data);
+void geo_data_release(geo_data *data);
+geo_data *geo_data_from_id(unsigned int id);
+unsigned int geo_data_id(const geo_data *data);
+unsigned int geo_data_num_polygons(const geo_data *data);
+void geo_data_get_stats(geo_data *data, geo_data_stats *stats);
+
+// LOOKUPS
+
+int geo_data_lookup(geo_data *data, double lng, double lat);
+int geo_data_hit_test(geo_data *data, double lng, double lat);
+int geo_data_hit_test_one(geo_data *data, unsigned int n, double lng, double lat);
+void geo_data_lookup_batch(geo_data *data, const double *coords, unsigned int num_points, int *results, unsigned int flags);
+unsigned int geo_data_classify_track(geo_data *data, const double *coords, unsigned int num_points, unsigned int *indices, int *polygons);
+unsigned int geo_data_lookup_path(geo_data *data, double lng, double lat, int *path, unsigned int max_path);
+
+// DISTANCE
+
+void geo_data_distance_to_boundary(geo_data *data, double lng, double lat, geo_data_distance *result);
+int geo_data_nearest(geo_data *data, double lng, double lat, unsigned int k, int *polygons, double *meters);
+
+// QUERIES, *results is malloced and owned by the caller
+
+int geo_data_query_box(geo_data *data, const geo_data_box *box, int exact, unsigned int **results, unsigned int *num_results);
+int geo_data_query_radius(geo_data *data, double lng, double lat, double meters, int exact, unsigned int **results,
+                          unsigned int *num_results);
+int geo_data_query_ring(geo_data *data, const double *coords, unsigned int num_points, int mode, unsigned int **results,
+                        unsigned int *num_results);
+
+// PROPERTIES
+
+unsigned int geo_data_prop_count(const geo_data *data);
+const char *geo_data_prop_name(const geo_data *data, unsigned int column);
+int geo_data_prop_find(geo_data *data, const char *name);
+int geo_data_prop_int64(geo_data *data, unsigned int column, unsigned int n, int64_t *value);
+const char *geo_data_prop_string(geo_data *data, unsigned int column, unsigned int n, unsigned int *len);
+
+// LAYERS
+
+geo_data_layers *geo_data_layers_open(const char **names, const char **filepaths, unsigned int num_layers, const geo_data_options *options,
+                                      int *status, unsigned int *failed);
+void geo_data_layers_destroy(geo_data_layers *layers);
+unsigned int geo_data_layers_count(const geo_data_layers *layers);
+const char *geo_data_layers_name(const geo_data_layers *layers, unsigned int n);
+geo_data *geo_data_layers_get(const geo_data_layers *layers, unsigned int n);
+void geo_data_lookup_all(geo_data_layers *layers, double lng, double lat, int *results);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,4102 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sched.h>
+#include <sys/syscall.h>
+
+#include "geodata.h"
+
+// GEODATA FILE FORMAT:
+//
+// this is a custom file format specifically for low memory high performance hit tests on a set of polygons
+//
+// FILE LAYOUT
+// unsigned char header[4] = "GEO!"
+// unsigned int num_polygons = <number of polygons that follow>
+// <POLYGON DATA>
+//
+// POLYGON LAYOUT
+// unsigned int num_coordinates = <number of coordinates that follow>
+// <COORDINATE DATA>
+//
+// COORDINATE LAYOUT
+// double longitude
+// double latitude
+//
+// TRAILER LAYOUT, any of the optional trailers below may follow the polygons, each at most once and in any order
+//
+// PROPERTIES LAYOUT
+// unsigned char header[4] = "PROP"
+// unsigned int num_columns = <number of columns that follow>
+// <COLUMN DATA>
+//
+// COLUMN LAYOUT
+// char name[32] = <nul padded column name>
+// unsigned int type = 1 for int64 values, 2 for dictionary encoded strings
+// int64 values[num_polygons] for int64 columns
+// unsigned int num_strings, unsigned int codes[num_polygons], unsigned int ends[num_strings + 1], char bytes[ends[num_strings]]
+// for string columns, string i of the dictionary runs from ends[i] to ends[i + 1] with ends[0] = 0
+//
+// HIERARCHY LAYOUT
+// unsigned char header[4] = "PRNT"
+// unsigned int parents[num_polygons] = <index of the polygon containing each polygon, 0xFFFFFFFF for top level ones>
+//
+
+// C IMPL
+
+typedef struct {
+    double lng;
+    double lat;
+} geo_data_coordinate;
+
+// an edge is stored as the byte offsets of its two coordinates in the polygon buffer, 64 bit as the buffer can pass 4GB
+typedef struct {
+    uint64_t from;
+    uint64_t to;
+    unsigned int polygon;
+} geo_data_edge;
+
+// uniform grid over the dataset extent, every cell lists the edges passing through it
+typedef struct {
+    geo_data_box extent;
+    unsigned int cols;
+    unsigned int rows;
+    double cell_lng;
+    double cell_lat;
+    unsigned int *cells; // cols * rows + 1 offsets into edges
+    geo_data_edge *edges;
+} geo_data_grid;
+
+// polygon edge copied into the quadtree so leaves are tested without touching the polygon buffer
+typedef struct {
+    geo_data_coordinate a;
+    geo_data_coordinate b;
+} geo_data_segment;
+
+typedef struct {
+    unsigned int child; // first of four children, 0 for leaves
+    int polygon; // leaves: first polygon containing the whole cell without an edge in it, or -1
+    unsigned int refs; // leaves: first geo_data_quad_ref
+    unsigned int num_refs;
+} geo_data_quad_node;
+
+// a polygon with edges in a leaf, its state at the reference point of the leaf and those edges
+typedef struct {
+    unsigned int polygon;
+    unsigned int inside;
+    unsigned int segments;
+    unsigned int num_segments;
+} geo_data_quad_ref;
+
+// adaptive quadtree over the dataset extent, only cells crossed by edges are subdivided
+typedef struct {
+    geo_data_box extent;
+    unsigned int num_nodes;
+    unsigned int num_refs;
+    unsigned int num_segments;
+    geo_data_quad_node *nodes;
+    geo_data_quad_ref *refs;
+    geo_data_segment *segments;
+} geo_data_quad;
+
+typedef struct {
+    geo_data_box box;
+    unsigned int first; // first child node, or first item for leaves
+    unsigned short count;
+    unsigned short leaf;
+} geo_data_rtree_node;
+
+// packed R-tree over the boxes of the valid polygons, nodes are stored level by level from the leaves up
+typedef struct {
+    unsigned int num_nodes; // the root is the last node
+    unsigned int num_items;
+    geo_data_rtree_node *nodes;
+    unsigned int *items; // polygon indices, leaves own consecutive runs
+} geo_data_rtree;
+
+// lng slabs of one large polygon, every slab lists the edges whose lng range overlaps it
+typedef struct {
+    unsigned int polygon;
+    unsigned int num_slabs;
+    double min_lng;
+    double slab_lng;
+    uint64_t cells; // first of num_slabs + 1 offsets in slab_cells
+} geo_data_slab_table;
+
+#define GEO_DATA_PROP_NAME_LEN 32
+#define GEO_DATA_PROP_INT64 1
+#define GEO_DATA_PROP_STRING 2
+
+// one property column, values are addressed by byte offset in props and may be unaligned
+typedef struct {
+    char name[GEO_DATA_PROP_NAME_LEN];
+    unsigned int type; // GEO_DATA_PROP_*
+    unsigned int num_strings;
+    uint64_t values; // int64 per polygon, or uint32 dictionary code per polygon for strings
+    uint64_t ends; // num_strings + 1 uint32 string ends followed by the string bytes
+} geo_data_prop_column;
+
+typedef struct geo_data {
+    unsigned int num_polygons;
+    uint64_t polygons_len;
+    unsigned int num_invalid; // polygons with non finite coordinates or fewer than 3 of them, never hit
+    uint8_t *polygons;
+    uint64_t *offsets; // byte offset of every polygon in polygons
+    geo_data_box *boxes;
+    geo_data_box *inner; // large rectangle inside every polygon, empty when none was found
+    unsigned int *lod; // mask slot per polygon or GEO_DATA_LOD_NONE
+    uint8_t *lod_masks; // 2 bit in/out/boundary raster per slot, GEO_DATA_LOD_BYTES each
+    unsigned int num_lod_masks;
+    uint8_t *kernels; // hit test kernel per polygon, GEO_DATA_KERNEL_*
+    int robust; // every predicate exact, see geo_data_orient_robust
+    geo_data_box domain; // lookups outside it are answered right away, see geo_data_in_domain
+    geo_data_slab_table *slabs; // edge slabs of the large polygons, ascending by polygon
+    unsigned int num_slabs;
+    uint64_t *slab_cells; // CSR offsets into slab_edges, num_slabs + 1 per table
+    unsigned int *slab_edges; // edge i runs from coordinate i - 1 to i
+    geo_data_grid grid;
+    geo_data_quad quad;
+    geo_data_rtree rtree;
+    geo_data_prop_column *prop_columns;
+    unsigned int num_prop_columns;
+    uint8_t *props; // the properties trailer of the file, see PROPERTIES LAYOUT
+    uint64_t props_len;
+    unsigned int *parents; // GEO_DATA_PARENT_NONE for top level polygons, NULL without a hierarchy
+    unsigned int *child_offsets; // num_polygons + 2, children of n from child_offsets[n] to [n + 1], the top level last
+    unsigned int *children; // ascending within every parent
+    
+    // single block holding every array above, NULL while they are allocated one by one, see geo_data_image
+    uint8_t *image;
+    size_t image_len;
+    int storage;
+    
+    // sharing, see geo_data_open
+    unsigned int refs;
+    unsigned int id;
+    char *key;
+    struct geo_data *next;
+    
+    // one copy per NUMA node, replicas[0] is the dataset itself, see geo_data_replicate
+    struct geo_data **replicas;
+    unsigned int num_replicas;
+} geo_data;
+
+void geo_data_options_init(geo_data_options *options);
+void geo_data_options_init(geo_data_options *options) {
+    memset(options, 0, sizeof(geo_data_options));
+}
+
+// version of the C API this library was built from, see geodata.h
+int geo_data_version(void) {
+    return GEO_DATA_VERSION;
+}
+
+unsigned int geo_data_num_polygons(const geo_data *data) {
+    return data ? data->num_polygons : 0;
+}
+
+#define GEO_DATA_GRID_MAX_SIDE 4096
+#define GEO_DATA_GRID_EDGES_PER_CELL 4
+
+static inline int geo_data_box_contains(const geo_data_box *box, double lng, double lat) {
+    return lng >= box->min_lng && lng <= box->max_lng && lat >= box->min_lat && lat <= box->max_lat;
+}
+
+// polygons crossing the antimeridian are unwrapped at load so their lng runs on past 180, see geo_data_unwrap. points
+// are tested against them one turn east as well, distances are measured to the closest of the three copies
+#define GEO_DATA_TURN 360.0
+static const double geo_data_turns[3] = {0.0, GEO_DATA_TURN, -GEO_DATA_TURN};
+
+static inline int geo_data_box_contains_turn(const geo_data_box *box, double lng, double lat) {
+    return geo_data_box_contains(box, lng, lat) || (box->max_lng > 180.0 && geo_data_box_contains(box, lng + GEO_DATA_TURN, lat));
+}
+
+// valid coordinates, also rejecting NaN
+static inline int geo_data_valid_point(double lng, double lat) {
+    return lng >= -180.0 && lng <= 180.0 && lat >= -90.0 && lat <= 90.0;
+}
+
+// first line reject for lookups: within the dataset extent and the configured query domain. a dataset covering one
+// country answers everything else from two boxes
+static inline int geo_data_in_domain(const geo_data *data, double lng, double lat) {
+    return geo_data_valid_point(lng, lat) && geo_data_box_contains_turn(&data->grid.extent, lng, lat) &&
+           geo_data_box_contains_turn(&data->domain, lng, lat);
+}
+
+// the whole world for NULL, otherwise the box clamped to valid latitudes with wrapping boxes unwrapped
+static void geo_data_set_domain(geo_data *data, const geo_data_box *domain) {
+    geo_data_box box;
+    box.min_lng = -180.0;
+    box.min_lat = -90.0;
+    box.max_lng = 180.0;
+    box.max_lat = 90.0;
+    if(domain) {
+        box.min_lng = domain->min_lng;
+        box.max_lng = domain->min_lng > domain->max_lng ? domain->max_lng + GEO_DATA_TURN : domain->max_lng;
+        box.min_lat = fmax(domain->min_lat, -90.0);
+        box.max_lat = fmin(domain->max_lat, 90.0);
+    }
+    data->domain = box;
+}
+
+static inline double geo_data_orient(const geo_data_coordinate *a, const geo_data_coordinate *b, const geo_data_coordinate *c) {
+    return (b->lng - a->lng) * (c->lat - a->lat) - (b->lat - a->lat) * (c->lng - a->lng);
+}
+
+// ROBUST PREDICATES
+
+// error free transformations after Shewchuk, "Adaptive Precision Floating-Point Arithmetic and Fast Robust Geometric
+// Predicates". they need IEEE double arithmetic, i.e. no x87 extended precision and no -ffast-math
+#define GEO_DATA_SPLITTER 134217729.0 // 2^27 + 1
+#define GEO_DATA_ORIENT_ERRBOUND ((3.0 + 16.0 * DBL_EPSILON / 2) * DBL_EPSILON / 2)
+
+static inline void geo_data_two_sum(double a, double b, double *x, double *y) {
+    *x = a + b;
+    double b_virtual = *x - a;
+    double a_virtual = *x - b_virtual;
+    *y = (a - a_virtual) + (b - b_virtual);
+}
+
+static inline void geo_data_split(double a, double *hi, double *lo) {
+    double c = GEO_DATA_SPLITTER * a;
+    *hi = c - (c - a);
+    *lo = a - *hi;
+}
+
+static inline void geo_data_two_product(double a, double b, double *x, double *y) {
+    double a_hi, a_lo, b_hi, b_lo;
+    *x = a * b;
+    geo_data_split(a, &a_hi, &a_lo);
+    geo_data_split(b, &b_hi, &b_lo);
+    *y = a_lo * b_lo - (((*x - a_hi * b_hi) - a_lo * b_hi) - a_hi * b_lo);
+}
+
+// orientation of c to a-b computed exactly: the six products of the expanded determinant are summed into a
+// nonoverlapping expansion whose largest component carries the sign
+static double geo_data_orient_exact(const geo_data_coordinate *a, const geo_data_coordinate *b, const geo_data_coordinate *c) {
+    const double terms[6][2] = {
+        {b->lng, c->lat}, {-b->lng, a->lat}, {-a->lng, c->lat}, {-b->lat, c->lng}, {a->lng, b->lat}, {a->lat, c->lng}
+    };
+    double expansion[12];
+    int len = 0;
+    for(int t = 0; t < 6; ++t) {
+        double parts[2];
+        geo_data_two_product(terms[t][0], terms[t][1], &parts[0], &parts[1]);
+        for(int k = 1; k >= 0; --k) {
+            // grow the expansion by one component, smallest first
+            double q = parts[k];
+            for(int i = 0; i < len; ++i) {
+                geo_data_two_sum(q, expansion[i], &q, &expansion[i]);
+            }
+            expansion[len++] = q;
+        }
+    }
+    for(int i = len - 1; i >= 0; --i) {
+        if(expansion[i] != 0.0) {
+            return expansion[i];
+        }
+    }
+    return 0.0;
+}
+
+// same sign as the exact orientation, the plain determinant is only trusted outside its rounding error
+static inline double geo_data_orient_robust(const geo_data_coordinate *a, const geo_data_coordinate *b, const geo_data_coordinate *c) {
+    double left = (b->lng - a->lng) * (c->lat - a->lat);
+    double right = (b->lat - a->lat) * (c->lng - a->lng);
+    double det = left - right;
+    double bound = GEO_DATA_ORIENT_ERRBOUND * (fabs(left) + fabs(right));
+    if(det > bound || -det > bound) {
+        return det;
+    }
+    return geo_data_orient_exact(a, b, c);
+}
+
+// conservative, touching segments count as intersecting
+static int geo_data_segments_intersect(const geo_data_coordinate *a, const geo_data_coordinate *b,
+                                       const geo_data_coordinate *c, const geo_data_coordinate *d) {
+    double d1 = geo_data_orient(c, d, a);
+    double d2 = geo_data_orient(c, d, b);
+    if((d1 > 0.0 && d2 > 0.0) || (d1 < 0.0 && d2 < 0.0)) {
+        return 0;
+    }
+    double d3 = geo_data_orient(a, b, c);
+    double d4 = geo_data_orient(a, b, d);
+    if((d3 > 0.0 && d4 > 0.0) || (d3 < 0.0 && d4 < 0.0)) {
+        return 0;
+    }
+    if(d1 == 0.0 && d2 == 0.0 && d3 == 0.0 && d4 == 0.0) {
+        // collinear, overlap of the projections decides
+        return fmax(a->lng, b->lng) >= fmin(c->lng, d->lng) && fmax(c->lng, d->lng) >= fmin(a->lng, b->lng) &&
+               fmax(a->lat, b->lat) >= fmin(c->lat, d->lat) && fmax(c->lat, d->lat) >= fmin(a->lat, b->lat);
+    }
+    return 1;
+}
+
+static inline int geo_data_polygon_hit_test(const geo_data_coordinate *coordinates, unsigned int num_coordinates, double lng, double lat) {
+    int c = 0;
+    int i = -1;
+    int l = num_coordinates;
+    int j = l - 1;
+    while(++i < l) {
+        if(((coordinates[i].lng <= lng && lng < coordinates[j].lng) ||
+            (coordinates[j].lng <= lng && lng < coordinates[i].lng)) &&
+           (lat < (coordinates[j].lat - coordinates[i].lat) * (lng - coordinates[i].lng) / (coordinates[j].lng - coordinates[i].lng) + coordinates[i].lat)) {
+            c = !c;
+        }
+        j = i;
+    }
+    return c;
+}
+
+// NUMA
+
+#define GEO_DATA_NUMA_MAX_NODES 64
+#define GEO_DATA_NUMA_MAX_CPUS 4096
+
+static unsigned int geo_data_numa_nodes_ = 1;
+static unsigned char geo_data_numa_cpu_nodes_[GEO_DATA_NUMA_MAX_CPUS];
+static pthread_once_t geo_data_numa_once_ = PTHREAD_ONCE_INIT;
+
+// reads the cpu to node map from sysfs, machines without it count as a single node
+static void geo_data_numa_init(void) {
+    DIR *dir = opendir("/sys/devices/system/node");
+    if(!dir) {
+        return;
+    }
+    struct dirent *entry;
+    while((entry = readdir(dir))) {
+        unsigned int node;
+        if(sscanf(entry->d_name, "node%u", &node) != 1 || node >= GEO_DATA_NUMA_MAX_NODES) {
+            continue;
+        }
+        if(node + 1 > geo_data_numa_nodes_) {
+            geo_data_numa_nodes_ = node + 1;
+        }
+        char path[128];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%u/cpulist", node);
+        FILE *handle = fopen(path, "r");
+        if(!handle) {
+            continue;
+        }
+        // ranges like "0-15,32-47"
+        unsigned int lo, hi;
+        char sep;
+        while(fscanf(handle, "%u", &lo) == 1) {
+            hi = lo;
+            if(fscanf(handle, "%c", &sep) == 1 && sep == '-') {
+                if(fscanf(handle, "%u", &hi) != 1) break;
+                if(fscanf(handle, "%c", &sep) != 1) sep = 0;
+            }
+            for(unsigned int cpu = lo; cpu <= hi && cpu < GEO_DATA_NUMA_MAX_CPUS; ++cpu) {
+                geo_data_numa_cpu_nodes_[cpu] = (unsigned char)node;
+            }
+            if(sep != ',') break;
+        }
+        fclose(handle);
+    }
+    closedir(dir);
+}
+
+static unsigned int geo_data_numa_num_nodes(void) {
+    pthread_once(&geo_data_numa_once_, geo_data_numa_init);
+    return geo_data_numa_nodes_;
+}
+
+// node of the cpu the calling thread runs on
+static inline unsigned int geo_data_numa_node(void) {
+    int cpu = sched_getcpu();
+    return cpu >= 0 && cpu < GEO_DATA_NUMA_MAX_CPUS ? geo_data_numa_cpu_nodes_[cpu] : 0;
+}
+
+// the replica closest to the calling thread
+static inline geo_data *geo_data_local(geo_data *data) {
+    if(data && data->num_replicas) {
+        unsigned int node = geo_data_numa_node();
+        return data->replicas[node < data->num_replicas ? node : 0];
+    }
+    return data;
+}
+
+// QUADTREE QUERY
+
+#define GEO_DATA_QUAD_DEPTH 16
+#define GEO_DATA_QUAD_EDGES 8
+#define GEO_DATA_QUAD_MEMORY (256 * 1024 * 1024)
+
+// quadrants are 0 south west, 1 south east, 2 north west and 3 north east
+static inline void geo_data_quad_child_box(const geo_data_box *parent, unsigned int quadrant, geo_data_box *child) {
+    double mid_lng = parent->min_lng + (parent->max_lng - parent->min_lng) * 0.5;
+    double mid_lat = parent->min_lat + (parent->max_lat - parent->min_lat) * 0.5;
+    child->min_lng = quadrant & 1 ? mid_lng : parent->min_lng;
+    child->max_lng = quadrant & 1 ? parent->max_lng : mid_lng;
+    child->min_lat = quadrant & 2 ? mid_lat : parent->min_lat;
+    child->max_lat = quadrant & 2 ? parent->max_lat : mid_lat;
+}
+
+// deliberately off center, axis aligned borders often run through the exact middle of a cell
+static inline void geo_data_quad_ref_point(const geo_data_box *box, geo_data_coordinate *ref) {
+    ref->lng = box->min_lng + (box->max_lng - box->min_lng) * 0.4567891;
+    ref->lat = box->min_lat + (box->max_lat - box->min_lat) * 0.5432109;
+}
+
+// parity rule for walking from p to the reference point r: a vertex on the line p-r counts as left of it, so
+// two edges sharing that vertex never both count
+static inline int geo_data_quad_crosses(const geo_data_coordinate *p, const geo_data_coordinate *r, const geo_data_segment *segment,
+                                        int robust) {
+    double (*orient)(const geo_data_coordinate *, const geo_data_coordinate *, const geo_data_coordinate *) =
+        robust ? geo_data_orient_robust : geo_data_orient;
+    int side_a = orient(p, r, &segment->a) >= 0.0;
+    int side_b = orient(p, r, &segment->b) >= 0.0;
+    if(side_a == side_b) {
+        return 0;
+    }
+    return (orient(&segment->a, &segment->b, p) >= 0.0) != (orient(&segment->a, &segment->b, r) >= 0.0);
+}
+
+// exactly on the segment, the walk's tie rule differs from the ray cast's there
+static inline int geo_data_quad_on_segment(const geo_data_coordinate *p, const geo_data_segment *segment) {
+    return fmin(segment->a.lng, segment->b.lng) <= p->lng && p->lng <= fmax(segment->a.lng, segment->b.lng) &&
+           fmin(segment->a.lat, segment->b.lat) <= p->lat && p->lat <= fmax(segment->a.lat, segment->b.lat) &&
+           geo_data_orient_robust(&segment->a, &segment->b, p) == 0.0;
+}
+
+// within GEO_DATA_QUAD_NEAR degrees of the segment, where the walk and the plain ray cast may round differently
+#define GEO_DATA_QUAD_NEAR 1e-9
+
+static inline int geo_data_quad_near_segment(const geo_data_coordinate *p, const geo_data_segment *segment) {
+    const geo_data_coordinate *a = &segment->a, *b = &segment->b;
+    if((p->lat < a->lat - GEO_DATA_QUAD_NEAR && p->lat < b->lat - GEO_DATA_QUAD_NEAR) ||
+       (p->lat > a->lat + GEO_DATA_QUAD_NEAR && p->lat > b->lat + GEO_DATA_QUAD_NEAR) ||
+       (p->lng < a->lng - GEO_DATA_QUAD_NEAR && p->lng < b->lng - GEO_DATA_QUAD_NEAR) ||
+       (p->lng > a->lng + GEO_DATA_QUAD_NEAR && p->lng > b->lng + GEO_DATA_QUAD_NEAR)) {
+        return 0;
+    }
+    return fabs(geo_data_orient(a, b, p)) <= GEO_DATA_QUAD_NEAR * (fabs(b->lng - a->lng) + fabs(b->lat - a->lat));
+}
+
+// coordinates of polygon n, found through the offset table
+static inline geo_data_coordinate *geo_data_polygon(const geo_data *data, unsigned int n, unsigned int *num_coordinates) {
+    uint8_t *polygon_ptr = data->polygons + data->offsets[n];
+    *num_coordinates = *(unsigned int *)polygon_ptr;
+    return (geo_data_coordinate *)(polygon_ptr + sizeof(unsigned int));
+}
+
+// KERNELS
+
+// polygons are dispatched by size class: below 16 vertices to a loop unrolled for their exact count, above
+// GEO_DATA_KERNEL_LARGE_MIN to a slab index that only visits the edges under the point, the rest to the plain ray cast
+#define GEO_DATA_KERNEL_GENERIC 0
+#define GEO_DATA_KERNEL_SMALL_MAX 15
+#define GEO_DATA_KERNEL_LARGE 16
+#define GEO_DATA_KERNEL_COUNT 17
+#define GEO_DATA_KERNEL_LARGE_MIN 10000
+#define GEO_DATA_SLAB_EDGES 16 // average edges per slab
+#define GEO_DATA_SLAB_MAX_FILL 16 // tables taking more than this many entries per edge fall back to the plain ray cast
+
+typedef int (*geo_data_kernel)(const geo_data *data, unsigned int n, const geo_data_coordinate *coordinates,
+                               unsigned int num_coordinates, double lng, double lat);
+
+// edge i to j of geo_data_polygon_hit_test, kept in the same form so every kernel gives identical answers. the robust
+// variant decides the same half open lng rule and replaces the interpolation by the exact side of the edge
+template <int Robust>
+static inline int geo_data_ray_crosses(const geo_data_coordinate *i, const geo_data_coordinate *j, double lng, double lat) {
+    if(!Robust) {
+        return ((i->lng <= lng && lng < j->lng) || (j->lng <= lng && lng < i->lng)) &&
+               (lat < (j->lat - i->lat) * (lng - i->lng) / (j->lng - i->lng) + i->lat);
+    }
+    if(!((i->lng <= lng && lng < j->lng) || (j->lng <= lng && lng < i->lng))) {
+        return 0;
+    }
+    geo_data_coordinate p;
+    p.lng = lng;
+    p.lat = lat;
+    double side = geo_data_orient_robust(i, j, &p);
+    return j->lng > i->lng ? side < 0.0 : side > 0.0;
+}
+
+template <int Robust>
+static int geo_data_kernel_generic(const geo_data *data, unsigned int n, const geo_data_coordinate *coordinates,
+                                   unsigned int num_coordinates, double lng, double lat) {
+    (void)data;
+    (void)n;
+    if(!Robust) {
+        return geo_data_polygon_hit_test(coordinates, num_coordinates, lng, lat);
+    }
+    int c = 0;
+    for(unsigned int i = 0, j = num_coordinates - 1; i < num_coordinates; j = i++) {
+        c ^= geo_data_ray_crosses<1>(&coordinates[i], &coordinates[j], lng, lat);
+    }
+    return c;
+}
+
+// the trip count is a constant so the compiler unrolls the whole loop
+template <unsigned int N, int Robust>
+static int geo_data_kernel_small(const geo_data *data, unsigned int n, const geo_data_coordinate *coordinates,
+                                 unsigned int num_coordinates, double lng, double lat) {
+    (void)data;
+    (void)n;
+    (void)num_coordinates;
+    int c = 0;
+    for(unsigned int i = 0; i < N; ++i) {
+        c ^= geo_data_ray_crosses<Robust>(&coordinates[i], &coordinates[i ? i - 1 : N - 1], lng, lat);
+    }
+    return c;
+}
+
+template <int Robust>
+static int geo_data_kernel_large(const geo_data *data, unsigned int n, const geo_data_coordinate *coordinates,
+                                 unsigned int num_coordinates, double lng, double lat) {
+    unsigned int lo = 0, hi = data->num_slabs;
+    while(lo < hi) {
+        unsigned int mid = (lo + hi) >> 1;
+        if(data->slabs[mid].polygon < n) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    const geo_data_slab_table *table = &data->slabs[lo];
+    int s = (int)floor((lng - table->min_lng) / table->slab_lng);
+    s = s < 0 ? 0 : (s >= (int)table->num_slabs ? (int)table->num_slabs - 1 : s);
+    
+    const uint64_t *cells = &data->slab_cells[table->cells];
+    int c = 0;
+    for(uint64_t k = cells[s]; k < cells[s + 1]; ++k) {
+        unsigned int i = data->slab_edges[k];
+        c ^= geo_data_ray_crosses<Robust>(&coordinates[i], &coordinates[i ? i - 1 : num_coordinates - 1], lng, lat);
+    }
+    return c;
+}
+
+#define GEO_DATA_KERNEL_TABLE(R) { \
+    geo_data_kernel_generic<R>, geo_data_kernel_generic<R>, geo_data_kernel_generic<R>, \
+    geo_data_kernel_small<3, R>, geo_data_kernel_small<4, R>, geo_data_kernel_small<5, R>, geo_data_kernel_small<6, R>, \
+    geo_data_kernel_small<7, R>, geo_data_kernel_small<8, R>, geo_data_kernel_small<9, R>, geo_data_kernel_small<10, R>, \
+    geo_data_kernel_small<11, R>, geo_data_kernel_small<12, R>, geo_data_kernel_small<13, R>, geo_data_kernel_small<14, R>, \
+    geo_data_kernel_small<15, R>, geo_data_kernel_large<R> \
+}
+
+// indexed by robust, then by kernel tag
+static const geo_data_kernel geo_data_kernels[2][GEO_DATA_KERNEL_COUNT] = {
+    GEO_DATA_KERNEL_TABLE(0),
+    GEO_DATA_KERNEL_TABLE(1)
+};
+
+// coarse raster of a polygon over its box, cells an edge passes through are boundary, all others are entirely in or out
+#define GEO_DATA_RASTER_SIZE 32
+#define GEO_DATA_RASTER_OUTSIDE 0
+#define GEO_DATA_RASTER_INSIDE 1
+#define GEO_DATA_RASTER_BOUNDARY 2
+#define GEO_DATA_LOD_NONE UINT_MAX
+#define GEO_DATA_LOD_SIZE GEO_DATA_RASTER_SIZE
+#define GEO_DATA_LOD_BYTES (GEO_DATA_LOD_SIZE * GEO_DATA_LOD_SIZE / 4)
+#define GEO_DATA_LOD_MIN_COORDINATES 64
+
+// raster cell of polygon n under a point inside its box, same rounding as the build so boundary padding covers it
+static inline int geo_data_lod_cell(const geo_data *data, unsigned int n, double lng, double lat) {
+    const geo_data_box *box = &data->boxes[n];
+    int c = (int)floor((lng - box->min_lng) / ((box->max_lng - box->min_lng) / GEO_DATA_LOD_SIZE));
+    int r = (int)floor((lat - box->min_lat) / ((box->max_lat - box->min_lat) / GEO_DATA_LOD_SIZE));
+    c = c < 0 ? 0 : (c >= GEO_DATA_LOD_SIZE ? GEO_DATA_LOD_SIZE - 1 : c);
+    r = r < 0 ? 0 : (r >= GEO_DATA_LOD_SIZE ? GEO_DATA_LOD_SIZE - 1 : r);
+    unsigned int i = r * GEO_DATA_LOD_SIZE + c;
+    return (data->lod_masks[(uint64_t)data->lod[n] * GEO_DATA_LOD_BYTES + (i >> 2)] >> ((i & 3) << 1)) & 3;
+}
+
+// hit tests polygon n alone, n has to be below num_polygons
+static inline int geo_data_hit_test_polygon(const geo_data *data, unsigned int n, double lng, double lat) {
+    if(!geo_data_box_contains(&data->boxes[n], lng, lat)) {
+        if(!(data->boxes[n].max_lng > 180.0) || !geo_data_box_contains(&data->boxes[n], lng + GEO_DATA_TURN, lat)) {
+            return 0;
+        }
+        lng += GEO_DATA_TURN;
+    }
+    if(data->inner && geo_data_box_contains(&data->inner[n], lng, lat)) {
+        return 1;
+    }
+    if(data->lod && data->lod[n] != GEO_DATA_LOD_NONE) {
+        int cell = geo_data_lod_cell(data, n, lng, lat);
+        if(cell != GEO_DATA_RASTER_BOUNDARY) {
+            return cell;
+        }
+    }
+    unsigned int num_coordinates;
+    geo_data_coordinate *coordinates = geo_data_polygon(data, n, &num_coordinates);
+    unsigned int kernel = data->kernels ? data->kernels[n] : GEO_DATA_KERNEL_GENERIC;
+    return geo_data_kernels[data->robust != 0][kernel](data, n, coordinates, num_coordinates, lng, lat);
+}
+
+// first polygon of an ascending candidate list, i.e. from a spatial index, containing the point or -1
+static inline int geo_data_lookup_candidates(const geo_data *data, const unsigned int *candidates, unsigned int num_candidates,
+                                             double lng, double lat) {
+    for(unsigned int i = 0; i < num_candidates; ++i) {
+        if(geo_data_hit_test_polygon(data, candidates[i], lng, lat)) {
+            return (int)candidates[i];
+        }
+    }
+    return -1;
+}
+
+static int geo_data_quad_lookup(const geo_data *data, double lng, double lat) {
+    const geo_data_quad *quad = &data->quad;
+    if(!geo_data_box_contains(&quad->extent, lng, lat)) {
+        return -1;
+    }
+    geo_data_box box = quad->extent;
+    const geo_data_quad_node *node = quad->nodes;
+    while(node->child) {
+        double mid_lng = box.min_lng + (box.max_lng - box.min_lng) * 0.5;
+        double mid_lat = box.min_lat + (box.max_lat - box.min_lat) * 0.5;
+        unsigned int quadrant = (lng >= mid_lng) | ((lat >= mid_lat) << 1);
+        geo_data_quad_child_box(&box, quadrant, &box);
+        node = &quad->nodes[node->child + quadrant];
+    }
+    
+    int result = node->polygon;
+    if(node->num_refs) {
+        geo_data_coordinate p, r;
+        p.lng = lng;
+        p.lat = lat;
+        geo_data_quad_ref_point(&box, &r);
+        
+        // refs are ascending, the first one containing the point wins unless the cell's own polygon comes first
+        const geo_data_quad_ref *ref = &quad->refs[node->refs];
+        const geo_data_quad_ref *end = ref + node->num_refs;
+        for(; ref < end && (result < 0 || ref->polygon < (unsigned int)result); ++ref) {
+            unsigned int inside = ref->inside;
+            const geo_data_segment *segment = &quad->segments[ref->segments];
+            for(unsigned int i = 0; i < ref->num_segments; ++i) {
+                // on or next to a border the polygon's own ray cast decides, so the tree answers like the scan
+                if(data->robust ? geo_data_quad_on_segment(&p, &segment[i]) : geo_data_quad_near_segment(&p, &segment[i])) {
+                    inside = geo_data_hit_test_polygon(data, ref->polygon, lng, lat);
+                    break;
+                }
+                inside ^= geo_data_quad_crosses(&p, &r, &segment[i], data->robust);
+            }
+            if(inside) {
+                result = (int)ref->polygon;
+                break;
+            }
+        }
+    }
+    return result;
+}
+
+// lookup in a replica already picked for the calling thread, for points known to be valid
+static int geo_data_lookup_local(const geo_data *data, double lng, double lat) {
+    if(!geo_data_box_contains_turn(&data->grid.extent, lng, lat) || !geo_data_box_contains_turn(&data->domain, lng, lat)) {
+        return -1;
+    }
+    if(data->quad.nodes) {
+        int result = geo_data_quad_lookup(data, lng, lat);
+        if(data->quad.extent.max_lng > 180.0) {
+            // the tree covers unwrapped polygons past 180, the first polygon of either copy of the point wins
+            int wrapped = geo_data_quad_lookup(data, lng + GEO_DATA_TURN, lat);
+            if(wrapped >= 0 && (result < 0 || wrapped < result)) {
+                result = wrapped;
+            }
+        }
+        return result;
+    }
+    // only the boxes are scanned, polygon data is touched for box hits alone
+    for(unsigned int n = 0; n < data->num_polygons; ++n) {
+        if(geo_data_hit_test_polygon(data, n, lng, lat)) {
+            return (int)n;
+        }
+    }
+    return -1;
+}
+
+int geo_data_lookup(geo_data *data, double lng, double lat);
+int geo_data_lookup(geo_data *data, double lng, double lat) {
+    data = geo_data_local(data);
+    if(!data || !geo_data_valid_point(lng, lat)) {
+        return -1;
+    }
+    return geo_data_lookup_local(data, lng, lat);
+}
+
+// public variant of geo_data_hit_test_polygon, returns 0 for an unknown polygon
+int geo_data_hit_test_one(geo_data *data, unsigned int n, double lng, double lat);
+int geo_data_hit_test_one(geo_data *data, unsigned int n, double lng, double lat) {
+    data = geo_data_local(data);
+    if(!data || n >= data->num_polygons) {
+        return 0;
+    }
+    return geo_data_hit_test_polygon(data, n, lng, lat);
+}
+
+int geo_data_hit_test(geo_data *data, double lng, double lat);
+int geo_data_hit_test(geo_data *data, double lng, double lat) {
+    return geo_data_lookup(data, lng, lat) >= 0;
+};
+
+// POOL
+
+#define GEO_DATA_CACHE_LINE 64
+#define GEO_DATA_BATCH_CHUNK 4096
+
+typedef void (*geo_data_task)(void *ctx, unsigned int begin, unsigned int end);
+
+// range of chunks owned by one participant, front and back packed so a single CAS claims from either end
+typedef struct {
+    uint64_t range;
+    uint8_t pad[GEO_DATA_CACHE_LINE - sizeof(uint64_t)];
+} geo_data_queue;
+
+typedef struct {
+    unsigned int num_threads;
+    pthread_t *threads;
+    geo_data_queue *queues; // num_threads + 1, the calling thread takes part as well
+    pthread_mutex_t run_mutex;
+    pthread_mutex_t mutex;
+    pthread_cond_t work_cond;
+    pthread_cond_t done_cond;
+    unsigned int generation;
+    unsigned int active;
+    geo_data_task task;
+    void *ctx;
+    unsigned int count;
+    unsigned int chunk;
+} geo_data_pool;
+
+typedef struct {
+    geo_data_pool *pool;
+    unsigned int index;
+} geo_data_worker;
+
+// the owner pops chunks from the front
+static int geo_data_queue_pop(geo_data_queue *queue, unsigned int *chunk) {
+    for(;;) {
+        uint64_t range = __atomic_load_n(&queue->range, __ATOMIC_ACQUIRE);
+        unsigned int front = (unsigned int)(range >> 32);
+        unsigned int back = (unsigned int)range;
+        if(front >= back) {
+            return 0;
+        }
+        uint64_t next = ((uint64_t)(front + 1) << 32) | back;
+        if(__atomic_compare_exchange_n(&queue->range, &range, next, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+            *chunk = front;
+            return 1;
+        }
+    }
+}
+
+// thieves take chunks from the back
+static int geo_data_queue_steal(geo_data_queue *queue, unsigned int *chunk) {
+    for(;;) {
+        uint64_t range = __atomic_load_n(&queue->range, __ATOMIC_ACQUIRE);
+        unsigned int front = (unsigned int)(range >> 32);
+        unsigned int back = (unsigned int)range;
+        if(front >= back) {
+            return 0;
+        }
+        uint64_t next = ((uint64_t)front << 32) | (back - 1);
+        if(__atomic_compare_exchange_n(&queue->range, &range, next, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+            *chunk = back - 1;
+            return 1;
+        }
+    }
+}
+
+static void geo_data_pool_work(geo_data_pool *pool, unsigned int self) {
+    unsigned int num_queues = pool->num_threads + 1;
+    unsigned int chunk;
+    for(;;) {
+        int found = geo_data_queue_pop(&pool->queues[self], &chunk);
+        for(unsigned int v = 1; !found && v < num_queues; ++v) {
+            found = geo_data_queue_steal(&pool->queues[(self + v) % num_queues], &chunk);
+        }
+        if(!found) {
+            return;
+        }
+        unsigned int begin = chunk * pool->chunk;
+        unsigned int end = pool->count - begin < pool->chunk ? pool->count : begin + pool->chunk;
+        pool->task(pool->ctx, begin, end);
+    }
+}
+
+// never returns, the worker and its pool live as long as the process
+static void *geo_data_pool_thread(void *arg) {
+    geo_data_worker *worker = (geo_data_worker *)arg;
+    geo_data_pool *pool = worker->pool;
+    unsigned int seen = 0;
+    
+    pthread_mutex_lock(&pool->mutex);
+    for(;;) {
+        while(pool->generation == seen) {
+            pthread_cond_wait(&pool->work_cond, &pool->mutex);
+        }
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->mutex);
+        
+        geo_data_pool_work(pool, worker->index);
+        
+        pthread_mutex_lock(&pool->mutex);
+        if(--pool->active == 0) {
+            pthread_cond_signal(&pool->done_cond);
+        }
+    }
+}
+
+// workers live as long as the process, the default pool is never torn down
+static geo_data_pool *geo_data_pool_create(unsigned int num_threads) {
+    geo_data_pool *pool = (geo_data_pool *)calloc(1, sizeof(geo_data_pool));
+    if(!pool) {
+        return NULL;
+    }
+    void *queues = NULL;
+    if(posix_memalign(&queues, GEO_DATA_CACHE_LINE, sizeof(geo_data_queue) * (num_threads + 1))) {
+        free(pool);
+        return NULL;
+    }
+    pool->queues = (geo_data_queue *)queues;
+    pool->threads = (pthread_t *)calloc(num_threads ? num_threads : 1, sizeof(pthread_t));
+    if(!pool->threads) {
+        free(pool->queues);
+        free(pool);
+        return NULL;
+    }
+    pthread_mutex_init(&pool->run_mutex, NULL);
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->work_cond, NULL);
+    pthread_cond_init(&pool->done_cond, NULL);
+    
+    for(unsigned int i = 0; i < num_threads; ++i) {
+        geo_data_worker *worker = (geo_data_worker *)malloc(sizeof(geo_data_worker));
+        if(!worker) {
+            break;
+        }
+        worker->pool = pool;
+        worker->index = i + 1;
+        if(pthread_create(&pool->threads[i], NULL, geo_data_pool_thread, worker)) {
+            free(worker);
+            break;
+        }
+        pool->num_threads++;
+    }
+    return pool;
+}
+
+// runs task over [0, count) in chunks, returns once every chunk is done
+static void geo_data_pool_run(geo_data_pool *pool, geo_data_task task, void *ctx, unsigned int count, unsigned int chunk) {
+    unsigned int num_chunks = (count + chunk - 1) / chunk;
+    if(!pool || pool->num_threads == 0 || num_chunks <= 1) {
+        if(count) task(ctx, 0, count);
+        return;
+    }
+    
+    pthread_mutex_lock(&pool->run_mutex);
+    
+    // deal the chunks out evenly, idle participants steal the rest
+    unsigned int num_queues = pool->num_threads + 1;
+    for(unsigned int i = 0; i < num_queues; ++i) {
+        uint64_t front = (uint64_t)num_chunks * i / num_queues;
+        uint64_t back = (uint64_t)num_chunks * (i + 1) / num_queues;
+        pool->queues[i].range = (front << 32) | back;
+    }
+    
+    pthread_mutex_lock(&pool->mutex);
+    pool->task = task;
+    pool->ctx = ctx;
+    pool->count = count;
+    pool->chunk = chunk;
+    pool->active = pool->num_threads;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->work_cond);
+    pthread_mutex_unlock(&pool->mutex);
+    
+    geo_data_pool_work(pool, 0);
+    
+    pthread_mutex_lock(&pool->mutex);
+    while(pool->active) {
+        pthread_cond_wait(&pool->done_cond, &pool->mutex);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    
+    pthread_mutex_unlock(&pool->run_mutex);
+}
+
+static geo_data_pool *geo_data_default_pool_ = NULL;
+static pthread_once_t geo_data_default_pool_once_ = PTHREAD_ONCE_INIT;
+
+static void geo_data_default_pool_init(void) {
+    long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    geo_data_default_pool_ = geo_data_pool_create(num_cpus > 1 ? (unsigned int)num_cpus - 1 : 0);
+}
+
+// shared pool sized to the machine, created on first use
+static geo_data_pool *geo_data_pool_default(void) {
+    pthread_once(&geo_data_default_pool_once_, geo_data_default_pool_init);
+    return geo_data_default_pool_;
+}
+
+// GRID
+
+typedef int (*geo_data_cell_visitor)(geo_data_grid *grid, unsigned int cell, void *ctx);
+
+static inline unsigned int geo_data_grid_clamp(double v, unsigned int n) {
+    if(!(v > 0.0)) {
+        return 0;
+    }
+    if(v >= (double)(n - 1)) {
+        return n - 1;
+    }
+    return (unsigned int)v;
+}
+
+// visits every cell the segment a-b passes through, row by row, stopping when visit returns non zero
+static int geo_data_grid_walk(geo_data_grid *grid, const geo_data_coordinate *a, const geo_data_coordinate *b,
+                              geo_data_cell_visitor visit, void *ctx) {
+    // pad every interval a little so both sides of a shared point agree on its cells
+    double eps_lng = grid->cell_lng * 1e-6;
+    double eps_lat = grid->cell_lat * 1e-6;
+    
+    double min_lat = fmin(a->lat, b->lat) - eps_lat;
+    double max_lat = fmax(a->lat, b->lat) + eps_lat;
+    if(max_lat < grid->extent.min_lat || min_lat > grid->extent.max_lat ||
+       fmax(a->lng, b->lng) + eps_lng < grid->extent.min_lng || fmin(a->lng, b->lng) - eps_lng > grid->extent.max_lng) {
+        return 0;
+    }
+    
+    unsigned int r0 = geo_data_grid_clamp((min_lat - grid->extent.min_lat) / grid->cell_lat, grid->rows);
+    unsigned int r1 = geo_data_grid_clamp((max_lat - grid->extent.min_lat) / grid->cell_lat, grid->rows);
+    for(unsigned int r = r0; r <= r1; ++r) {
+        double lo = a->lng;
+        double hi = b->lng;
+        if(a->lat != b->lat) {
+            double y0 = grid->extent.min_lat + r * grid->cell_lat - eps_lat;
+            double y1 = y0 + grid->cell_lat + 2.0 * eps_lat;
+            double t0 = (y0 - a->lat) / (b->lat - a->lat);
+            double t1 = (y1 - a->lat) / (b->lat - a->lat);
+            t0 = fmin(fmax(t0, 0.0), 1.0);
+            t1 = fmin(fmax(t1, 0.0), 1.0);
+            lo = a->lng + (b->lng - a->lng) * t0;
+            hi = a->lng + (b->lng - a->lng) * t1;
+        }
+        if(lo > hi) {
+            double t = lo; lo = hi; hi = t;
+        }
+        unsigned int c0 = geo_data_grid_clamp((lo - eps_lng - grid->extent.min_lng) / grid->cell_lng, grid->cols);
+        unsigned int c1 = geo_data_grid_clamp((hi + eps_lng - grid->extent.min_lng) / grid->cell_lng, grid->cols);
+        for(unsigned int c = c0; c <= c1; ++c) {
+            if(visit(grid, r * grid->cols + c, ctx)) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+typedef struct {
+    geo_data_edge edge;
+    int fill;
+} geo_data_grid_build_ctx;
+
+// safe to run from several threads at once, the order of edges within a cell is arbitrary
+static int geo_data_grid_insert(geo_data_grid *grid, unsigned int cell, void *ctx) {
+    geo_data_grid_build_ctx *build = (geo_data_grid_build_ctx *)ctx;
+    if(build->fill) {
+        grid->edges[__atomic_fetch_add(&grid->cells[cell], 1, __ATOMIC_RELAXED)] = build->edge;
+    } else {
+        __atomic_fetch_add(&grid->cells[cell + 1], 1, __ATOMIC_RELAXED);
+    }
+    return 0;
+}
+
+typedef struct {
+    const uint8_t *polygons;
+    const geo_data_coordinate *a;
+    const geo_data_coordinate *b;
+} geo_data_grid_cross_ctx;
+
+static int geo_data_grid_cross(geo_data_grid *grid, unsigned int cell, void *ctx) {
+    geo_data_grid_cross_ctx *cross = (geo_data_grid_cross_ctx *)ctx;
+    for(unsigned int e = grid->cells[cell]; e < grid->cells[cell + 1]; ++e) {
+        const geo_data_edge *edge = &grid->edges[e];
+        if(geo_data_segments_intersect(cross->a, cross->b,
+                                       (const geo_data_coordinate *)(cross->polygons + edge->from),
+                                       (const geo_data_coordinate *)(cross->polygons + edge->to))) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+#define GEO_DATA_INDEX_CHUNK 16
+
+// shifts the vertices of a polygon by whole turns so every edge is short, i.e. none spans more than half a turn, and
+// the smallest lng lies in [-180, 180). lookups only retry one turn east, so rings stored already unwrapped to the
+// west or past 180 are rebased too. rings going all the way around, like one enclosing a pole, and rings with non
+// finite coordinates are left alone
+static void geo_data_unwrap(geo_data_coordinate *coordinates, unsigned int num_coordinates) {
+    if(!isfinite(coordinates[0].lng)) {
+        return;
+    }
+    double shift = 0.0, prev = coordinates[0].lng, min_lng = coordinates[0].lng;
+    int crosses = 0;
+    for(unsigned int i = 1; i < num_coordinates; ++i) {
+        if(!isfinite(coordinates[i].lng)) {
+            return;
+        }
+        double lng = coordinates[i].lng + shift;
+        while(lng - prev > 180.0) {
+            shift -= GEO_DATA_TURN;
+            lng -= GEO_DATA_TURN;
+            crosses = 1;
+        }
+        while(lng - prev < -180.0) {
+            shift += GEO_DATA_TURN;
+            lng += GEO_DATA_TURN;
+            crosses = 1;
+        }
+        prev = lng;
+        min_lng = fmin(min_lng, lng);
+    }
+    if(fabs(prev - coordinates[0].lng) > 180.0) {
+        return;
+    }
+    
+    double base = 0.0;
+    while(min_lng + base < -180.0) {
+        base += GEO_DATA_TURN;
+    }
+    while(min_lng + base >= 180.0) {
+        base -= GEO_DATA_TURN;
+    }
+    if(!crosses && base == 0.0) {
+        return;
+    }
+    shift = 0.0;
+    prev = coordinates[0].lng;
+    coordinates[0].lng += base;
+    for(unsigned int i = 1; i < num_coordinates; ++i) {
+        double lng = coordinates[i].lng + shift;
+        while(lng - prev > 180.0) {
+            shift -= GEO_DATA_TURN;
+            lng -= GEO_DATA_TURN;
+        }
+        while(lng - prev < -180.0) {
+            shift += GEO_DATA_TURN;
+            lng += GEO_DATA_TURN;
+        }
+        prev = lng;
+        coordinates[i].lng = lng + base;
+    }
+}
+
+// boxes every polygon in [begin, end), polygons failing validation get an empty box so nothing ever hits them
+static void geo_data_index_boxes_task(void *ctx, unsigned int begin, unsigned int end) {
+    geo_data *data = (geo_data *)ctx;
+    for(unsigned int n = begin; n < end; ++n) {
+        unsigned int num_coordinates;
+        geo_data_coordinate *coordinates = geo_data_polygon(data, n, &num_coordinates);
+        
+        if(num_coordinates >= 3) {
+            geo_data_unwrap(coordinates, num_coordinates);
+        }
+        
+        geo_data_box box;
+        box.min_lng = box.min_lat = DBL_MAX;
+        box.max_lng = box.max_lat = -DBL_MAX;
+        int valid = num_coordinates >= 3;
+        for(unsigned int i = 0; i < num_coordinates; ++i) {
+            valid &= isfinite(coordinates[i].lng) && isfinite(coordinates[i].lat);
+            box.min_lng = fmin(box.min_lng, coordinates[i].lng);
+            box.min_lat = fmin(box.min_lat, coordinates[i].lat);
+            box.max_lng = fmax(box.max_lng, coordinates[i].lng);
+            box.max_lat = fmax(box.max_lat, coordinates[i].lat);
+        }
+        if(!valid) {
+            box.min_lng = box.min_lat = DBL_MAX;
+            box.max_lng = box.max_lat = -DBL_MAX;
+        }
+        data->boxes[n] = box;
+    }
+}
+
+typedef struct {
+    geo_data *data;
+    int fill;
+} geo_data_index_grid_ctx;
+
+static void geo_data_index_grid_task(void *ctx, unsigned int begin, unsigned int end) {
+    geo_data_index_grid_ctx *index = (geo_data_index_grid_ctx *)ctx;
+    geo_data *data = index->data;
+    geo_data_grid_build_ctx build;
+    build.fill = index->fill;
+    for(unsigned int n = begin; n < end; ++n) {
+        if(data->boxes[n].min_lng > data->boxes[n].max_lng) {
+            continue;
+        }
+        unsigned int num_coordinates;
+        geo_data_coordinate *coordinates = geo_data_polygon(data, n, &num_coordinates);
+        
+        build.edge.polygon = n;
+        for(unsigned int i = 0, j = num_coordinates - 1; i < num_coordinates; j = i++) {
+            build.edge.from = (uint64_t)((uint8_t *)&coordinates[j] - data->polygons);
+            build.edge.to = (uint64_t)((uint8_t *)&coordinates[i] - data->polygons);
+            geo_data_grid_walk(&data->grid, &coordinates[j], &coordinates[i], geo_data_grid_insert, &build);
+        }
+    }
+}
+
+#define GEO_DATA_INNER_MIN_COORDINATES 16
+
+static int geo_data_compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+// rasterises a polygon over its box: marks every cell an edge passes through as boundary and classifies the rest by
+// scanline parity through their centers, returns -1 when the box is degenerate or memory runs out
+static int geo_data_polygon_raster(const geo_data_coordinate *coordinates, unsigned int num_coordinates, const geo_data_box *box,
+                                   uint8_t *cells) {
+    const int size = GEO_DATA_RASTER_SIZE;
+    double cell_lng = (box->max_lng - box->min_lng) / size;
+    double cell_lat = (box->max_lat - box->min_lat) / size;
+    if(!(cell_lng > 0.0) || !(cell_lat > 0.0)) {
+        return -1;
+    }
+    double *crossings = (double *)malloc(sizeof(double) * num_coordinates);
+    if(!crossings) {
+        return -1;
+    }
+    memset(cells, GEO_DATA_RASTER_OUTSIDE, size * size);
+    
+    // boundary cells, every interval padded so rounding never leaves an edge's cell unmarked
+    double eps_lng = cell_lng * 1e-6, eps_lat = cell_lat * 1e-6;
+    for(unsigned int i = 0, j = num_coordinates - 1; i < num_coordinates; j = i++) {
+        const geo_data_coordinate *a = &coordinates[j], *b = &coordinates[i];
+        int r0 = (int)floor((fmin(a->lat, b->lat) - eps_lat - box->min_lat) / cell_lat);
+        int r1 = (int)floor((fmax(a->lat, b->lat) + eps_lat - box->min_lat) / cell_lat);
+        for(int r = r0 < 0 ? 0 : r0; r <= r1 && r < size; ++r) {
+            double lo = a->lng, hi = b->lng;
+            if(a->lat != b->lat) {
+                double y0 = box->min_lat + r * cell_lat - eps_lat;
+                double y1 = y0 + cell_lat + 2.0 * eps_lat;
+                double t0 = fmin(fmax((y0 - a->lat) / (b->lat - a->lat), 0.0), 1.0);
+                double t1 = fmin(fmax((y1 - a->lat) / (b->lat - a->lat), 0.0), 1.0);
+                lo = a->lng + (b->lng - a->lng) * t0;
+                hi = a->lng + (b->lng - a->lng) * t1;
+            }
+            if(lo > hi) {
+                double t = lo; lo = hi; hi = t;
+            }
+            int c0 = (int)floor((lo - eps_lng - box->min_lng) / cell_lng);
+            int c1 = (int)floor((hi + eps_lng - box->min_lng) / cell_lng);
+            for(int c = c0 < 0 ? 0 : c0; c <= c1 && c < size; ++c) {
+                cells[r * size + c] = GEO_DATA_RASTER_BOUNDARY;
+            }
+        }
+    }
+    
+    // untouched cells are entirely in or out, their center decides
+    for(int r = 0; r < size; ++r) {
+        double y = box->min_lat + (r + 0.5) * cell_lat;
+        unsigned int num_crossings = 0;
+        for(unsigned int i = 0, j = num_coordinates - 1; i < num_coordinates; j = i++) {
+            const geo_data_coordinate *a = &coordinates[j], *b = &coordinates[i];
+            if((a->lat <= y) != (b->lat <= y)) {
+                crossings[num_crossings++] = a->lng + (y - a->lat) * (b->lng - a->lng) / (b->lat - a->lat);
+            }
+        }
+        qsort(crossings, num_crossings, sizeof(double), geo_data_compare_doubles);
+        unsigned int k = 0;
+        for(int c = 0; c < size; ++c) {
+            double x = box->min_lng + (c + 0.5) * cell_lng;
+            while(k < num_crossings && crossings[k] < x) {
+                ++k;
+            }
+            if(cells[r * size + c] == GEO_DATA_RASTER_OUTSIDE && (k & 1)) {
+                cells[r * size + c] = GEO_DATA_RASTER_INSIDE;
+            }
+        }
+    }
+    free(crossings);
+    return 0;
+}
+
+// largest all inside block of raster cells as a box, empty when there is none
+static void geo_data_inner_box(const uint8_t *cells, const geo_data_box *box, geo_data_box *inner) {
+    const int size = GEO_DATA_RASTER_SIZE;
+    double cell_lng = (box->max_lng - box->min_lng) / size;
+    double cell_lat = (box->max_lat - box->min_lat) / size;
+    
+    // largest rectangle, histogram per row
+    int heights[GEO_DATA_RASTER_SIZE + 1] = {0};
+    int best_area = 0, best_r = 0, best_c = 0, best_w = 0, best_h = 0;
+    for(int r = 0; r < size; ++r) {
+        for(int c = 0; c < size; ++c) {
+            heights[c] = cells[r * size + c] == GEO_DATA_RASTER_INSIDE ? heights[c] + 1 : 0;
+        }
+        int stack[GEO_DATA_RASTER_SIZE + 1], top = 0;
+        for(int c = 0; c <= size; ++c) {
+            int h = c < size ? heights[c] : 0;
+            while(top && heights[stack[top - 1]] >= h) {
+                int height = heights[stack[--top]];
+                int left = top ? stack[top - 1] + 1 : 0;
+                if(height * (c - left) > best_area) {
+                    best_area = height * (c - left);
+                    best_r = r - height + 1;
+                    best_c = left;
+                    best_w = c - left;
+                    best_h = height;
+                }
+            }
+            stack[top++] = c;
+        }
+    }
+    if(best_area) {
+        inner->min_lng = box->min_lng + best_c * cell_lng;
+        inner->max_lng = box->min_lng + (best_c + best_w) * cell_lng;
+        inner->min_lat = box->min_lat + best_r * cell_lat;
+        inner->max_lat = box->min_lat + (best_r + best_h) * cell_lat;
+    }
+}
+
+static void geo_data_index_inner_task(void *ctx, unsigned int begin, unsigned int end) {
+    geo_data *data = (geo_data *)ctx;
+    uint8_t cells[GEO_DATA_RASTER_SIZE * GEO_DATA_RASTER_SIZE];
+    for(unsigned int n = begin; n < end; ++n) {
+        unsigned int num_coordinates;
+        geo_data_coordinate *coordinates = geo_data_polygon(data, n, &num_coordinates);
+        geo_data_box *inner = &data->inner[n];
+        inner->min_lng = inner->min_lat = DBL_MAX;
+        inner->max_lng = inner->max_lat = -DBL_MAX;
+        
+        // small polygons are cheap enough to test edge by edge
+        unsigned int lod = data->lod ? data->lod[n] : GEO_DATA_LOD_NONE;
+        if(num_coordinates < GEO_DATA_INNER_MIN_COORDINATES || data->boxes[n].min_lng > data->boxes[n].max_lng ||
+           geo_data_polygon_raster(coordinates, num_coordinates, &data->boxes[n], cells) < 0) {
+            if(lod != GEO_DATA_LOD_NONE) {
+                memset(&data->lod_masks[(uint64_t)lod * GEO_DATA_LOD_BYTES], 0xff, GEO_DATA_LOD_BYTES); // all boundary
+            }
+            continue;
+        }
+        geo_data_inner_box(cells, &data->boxes[n], inner);
+        
+        if(lod != GEO_DATA_LOD_NONE) {
+            uint8_t *mask = &data->lod_masks[(uint64_t)lod * GEO_DATA_LOD_BYTES];
+            memset(mask, 0, GEO_DATA_LOD_BYTES);
+            for(int i = 0; i < GEO_DATA_RASTER_SIZE * GEO_DATA_RASTER_SIZE; ++i) {
+                mask[i >> 2] |= cells[i] << ((i & 3) << 1);
+            }
+        }
+    }
+}
+
+// hands out a mask slot to every polygon large enough to need one, the masks themselves are filled in by the inner task
+static int geo_data_lod_alloc(geo_data *data) {
+    data->lod = (unsigned int *)malloc(sizeof(unsigned int) * (data->num_polygons ? data->num_polygons : 1));
+    if(!data->lod) {
+        return -1;
+    }
+    unsigned int num_masks = 0;
+    for(unsigned int n = 0; n < data->num_polygons; ++n) {
+        unsigned int num_coordinates;
+        geo_data_polygon(data, n, &num_coordinates);
+        data->lod[n] = num_coordinates >= GEO_DATA_LOD_MIN_COORDINATES ? num_masks++ : GEO_DATA_LOD_NONE;
+    }
+    data->num_lod_masks = num_masks;
+    data->lod_masks = (uint8_t *)malloc((uint64_t)GEO_DATA_LOD_BYTES * (num_masks ? num_masks : 1));
+    if(!data->lod_masks) {
+        free(data->lod);
+        data->lod = NULL;
+        data->num_lod_masks = 0;
+        return -1;
+    }
+    return 0;
+}
+
+// slab lo to hi of the edge i - 1 to i, false for edges no north ray can cross
+static int geo_data_slab_span(const geo_data_coordinate *coordinates, unsigned int num_coordinates, unsigned int i,
+                              const geo_data_slab_table *table, int *lo, int *hi) {
+    double a = coordinates[i].lng, b = coordinates[i ? i - 1 : num_coordinates - 1].lng;
+    if(a == b) {
+        return 0;
+    }
+    // same rounding as the lookup so that floor stays monotone between the edge ends and the point
+    int s0 = (int)floor((fmin(a, b) - table->min_lng) / table->slab_lng);
+    int s1 = (int)floor((fmax(a, b) - table->min_lng) / table->slab_lng);
+    *lo = s0 < 0 ? 0 : (s0 >= (int)table->num_slabs ? (int)table->num_slabs - 1 : s0);
+    *hi = s1 < 0 ? 0 : (s1 >= (int)table->num_slabs ? (int)table->num_slabs - 1 : s1);
+    return 1;
+}
+
+// tags every polygon with its kernel and builds the slab tables of the large ones, polygons keep the generic kernel
+// whenever memory runs out
+static void geo_data_kernels_build(geo_data *data) {
+    data->kernels = (uint8_t *)malloc(data->num_polygons ? data->num_polygons : 1);
+    if(!data->kernels) {
+        return;
+    }
+    unsigned int num_large = 0;
+    for(unsigned int n = 0; n < data->num_polygons; ++n) {
+        unsigned int num_coordinates;
+        geo_data_polygon(data, n, &num_coordinates);
+        if(num_coordinates <= GEO_DATA_KERNEL_SMALL_MAX) {
+            data->kernels[n] = (uint8_t)num_coordinates;
+        } else if(num_coordinates >= GEO_DATA_KERNEL_LARGE_MIN && data->boxes[n].min_lng < data->boxes[n].max_lng) {
+            data->kernels[n] = GEO_DATA_KERNEL_LARGE;
+            ++num_large;
+        } else {
+            data->kernels[n] = GEO_DATA_KERNEL_GENERIC;
+        }
+    }
+    if(!num_large) {
+        return;
+    }
+    
+    data->slabs = (geo_data_slab_table *)malloc(sizeof(geo_data_slab_table) * num_large);
+    if(!data->slabs) {
+        memset(data->kernels, GEO_DATA_KERNEL_GENERIC, data->num_polygons);
+        return;
+    }
+    
+    // sizes first, one offset array and one edge array cover all tables
+    uint64_t num_cells = 0, num_edges = 0;
+    for(unsigned int n = 0; n < data->num_polygons; ++n) {
+        if(data->kernels[n] != GEO_DATA_KERNEL_LARGE) {
+            continue;
+        }
+        unsigned int num_coordinates;
+        geo_data_coordinate *coordinates = geo_data_polygon(data, n, &num_coordinates);
+        geo_data_slab_table *table = &data->slabs[data->num_slabs];
+        table->polygon = n;
+        table->num_slabs = num_coordinates / GEO_DATA_SLAB_EDGES;
+        table->min_lng = data->boxes[n].min_lng;
+        table->slab_lng = (data->boxes[n].max_lng - data->boxes[n].min_lng) / table->num_slabs;
+        table->cells = num_cells;
+        
+        uint64_t entries = 0;
+        for(unsigned int i = 0; i < num_coordinates; ++i) {
+            int lo, hi;
+            if(geo_data_slab_span(coordinates, num_coordinates, i, table, &lo, &hi)) {
+                entries += hi - lo + 1;
+            }
+        }
+        if(entries > (uint64_t)GEO_DATA_SLAB_MAX_FILL * num_coordinates) {
+            data->kernels[n] = GEO_DATA_KERNEL_GENERIC;
+            continue;
+        }
+        num_cells += table->num_slabs + 1;
+        num_edges += entries;
+        ++data->num_slabs;
+    }
+    
+    data->slab_cells = (uint64_t *)calloc(num_cells ? num_cells : 1, sizeof(uint64_t));
+    data->slab_edges = (unsigned int *)malloc(sizeof(unsigned int) * (num_edges ? num_edges : 1));
+    if(!data->slab_cells || !data->slab_edges) {
+        for(unsigned int t = 0; t < data->num_slabs; ++t) {
+            data->kernels[data->slabs[t].polygon] = GEO_DATA_KERNEL_GENERIC;
+        }
+        free(data->slabs);
+        free(data->slab_cells);
+        free(data->slab_edges);
+        data->slabs = NULL;
+        data->slab_cells = NULL;
+        data->slab_edges = NULL;
+        data->num_slabs = 0;
+        return;
+    }
+    
+    uint64_t offset = 0;
+    for(unsigned int t = 0; t < data->num_slabs; ++t) {
+        const geo_data_slab_table *table = &data->slabs[t];
+        unsigned int num_coordinates;
+        geo_data_coordinate *coordinates = geo_data_polygon(data, table->polygon, &num_coordinates);
+        uint64_t *cells = &data->slab_cells[table->cells];
+        for(unsigned int i = 0; i < num_coordinates; ++i) {
+            int lo, hi;
+            if(geo_data_slab_span(coordinates, num_coordinates, i, table, &lo, &hi)) {
+                for(int s = lo; s <= hi; ++s) {
+                    ++cells[s];
+                }
+            }
+        }
+        // slab ends first, filling from the back turns them into the slab starts
+        for(unsigned int s = 0; s < table->num_slabs; ++s) {
+            offset += cells[s];
+            cells[s] = offset;
+        }
+        cells[table->num_slabs] = offset;
+        for(unsigned int i = num_coordinates; i-- > 0;) {
+            int lo, hi;
+            if(geo_data_slab_span(coordinates, num_coordinates, i, table, &lo, &hi)) {
+                for(int s = lo; s <= hi; ++s) {
+                    data->slab_edges[--cells[s]] = i;
+                }
+            }
+        }
+    }
+}
+
+static int geo_data_rtree_build(geo_data *data);
+
+// validates the polygons and builds their boxes and the edge grid on the default pool, needs the offset table
+static int geo_data_index_build(geo_data *data) {
+    data->boxes = (geo_data_box *)malloc(sizeof(geo_data_box) * (data->num_polygons ? data->num_polygons : 1));
+    if(!data->boxes) {
+        return -1;
+    }
+    
+    geo_data_pool *pool = geo_data_pool_default();
+    geo_data_pool_run(pool, geo_data_index_boxes_task, data, data->num_polygons, GEO_DATA_INDEX_CHUNK);
+    
+    // fast accept boxes and level of detail masks are optional, lookups work without them
+    data->inner = (geo_data_box *)malloc(sizeof(geo_data_box) * (data->num_polygons ? data->num_polygons : 1));
+    if(data->inner) {
+        geo_data_lod_alloc(data);
+        geo_data_pool_run(pool, geo_data_index_inner_task, data, data->num_polygons, 1);
+    }
+    geo_data_kernels_build(data);
+    if(geo_data_rtree_build(data)) {
+        return -1;
+    }
+    
+    geo_data_grid *grid = &data->grid;
+    grid->extent.min_lng = grid->extent.min_lat = DBL_MAX;
+    grid->extent.max_lng = grid->extent.max_lat = -DBL_MAX;
+    
+    unsigned long long num_edges = 0;
+    data->num_invalid = 0;
+    for(unsigned int n = 0; n < data->num_polygons; ++n) {
+        const geo_data_box *box = &data->boxes[n];
+        if(box->min_lng > box->max_lng) {
+            data->num_invalid++;
+            continue;
+        }
+        grid->extent.min_lng = fmin(grid->extent.min_lng, box->min_lng);
+        grid->extent.min_lat = fmin(grid->extent.min_lat, box->min_lat);
+        grid->extent.max_lng = fmax(grid->extent.max_lng, box->max_lng);
+        grid->extent.max_lat = fmax(grid->extent.max_lat, box->max_lat);
+        unsigned int num_coordinates;
+        geo_data_polygon(data, n, &num_coordinates);
+        num_edges += num_coordinates;
+    }
+    
+    if(num_edges == 0) {
+        return 0;
+    }
+    
+    // size the grid for a handful of edges per cell, keeping the cells roughly square
+    double width = fmax(grid->extent.max_lng - grid->extent.min_lng, 1e-9);
+    double height = fmax(grid->extent.max_lat - grid->extent.min_lat, 1e-9);
+    double num_cells = fmax((double)num_edges / GEO_DATA_GRID_EDGES_PER_CELL, 1.0);
+    double side = sqrt(width * height / num_cells);
+    grid->cols = (unsigned int)fmin(fmax(ceil(width / side), 1.0), GEO_DATA_GRID_MAX_SIDE);
+    grid->rows = (unsigned int)fmin(fmax(ceil(height / side), 1.0), GEO_DATA_GRID_MAX_SIDE);
+    grid->cell_lng = width / grid->cols;
+    grid->cell_lat = height / grid->rows;
+    
+    grid->cells = (unsigned int *)calloc(grid->cols * grid->rows + 1, sizeof(unsigned int));
+    if(!grid->cells) {
+        return -1;
+    }
+    
+    // two passes, count then fill
+    geo_data_index_grid_ctx ctx;
+    ctx.data = data;
+    for(ctx.fill = 0; ctx.fill < 2; ++ctx.fill) {
+        if(ctx.fill) {
+            unsigned int num_cells = grid->cols * grid->rows;
+            for(unsigned int c = 0; c < num_cells; ++c) {
+                grid->cells[c + 1] += grid->cells[c];
+            }
+            grid->edges = (geo_data_edge *)malloc(sizeof(geo_data_edge) * (grid->cells[num_cells] ? grid->cells[num_cells] : 1));
+            if(!grid->edges) {
+                return -1;
+            }
+        }
+        geo_data_pool_run(pool, geo_data_index_grid_task, &ctx, data->num_polygons, GEO_DATA_INDEX_CHUNK);
+    }
+    
+    // the fill pass advanced every offset to the start of the next cell, shift them back
+    for(unsigned int c = grid->cols * grid->rows; c > 0; --c) {
+        grid->cells[c] = grid->cells[c - 1];
+    }
+    grid->cells[0] = 0;
+    
+    return 0;
+}
+
+// QUADTREE BUILD
+
+typedef struct {
+    geo_data_box box;
+    unsigned int node;
+    unsigned int depth;
+    int polygon;
+    unsigned int num_refs;
+    geo_data_quad_ref *refs; // segments of these refs index into segments below
+    unsigned int num_segments;
+    geo_data_segment *segments;
+} geo_data_quad_pending;
+
+static int geo_data_grow(void **ptr, unsigned int *capacity, unsigned int needed, size_t size) {
+    if(needed <= *capacity) {
+        return 0;
+    }
+    unsigned int next = *capacity ? *capacity : 64;
+    while(next < needed) {
+        next *= 2;
+    }
+    void *grown = realloc(*ptr, size * next);
+    if(!grown) {
+        return -1;
+    }
+    *ptr = grown;
+    *capacity = next;
+    return 0;
+}
+
+// liang barsky clip against the box grown by eps, touching counts
+static int geo_data_segment_in_box(const geo_data_segment *segment, const geo_data_box *box, double eps) {
+    double dx = segment->b.lng - segment->a.lng;
+    double dy = segment->b.lat - segment->a.lat;
+    double p[4] = {-dx, dx, -dy, dy};
+    double q[4] = {segment->a.lng - (box->min_lng - eps), (box->max_lng + eps) - segment->a.lng,
+                   segment->a.lat - (box->min_lat - eps), (box->max_lat + eps) - segment->a.lat};
+    double t0 = 0.0, t1 = 1.0;
+    for(int i = 0; i < 4; ++i) {
+        if(p[i] == 0.0) {
+            if(q[i] < 0.0) {
+                return 0;
+            }
+        } else {
+            double t = q[i] / p[i];
+            if(p[i] < 0.0) {
+                if(t > t1) return 0;
+                if(t > t0) t0 = t;
+            } else {
+                if(t < t0) return 0;
+                if(t < t1) t1 = t;
+            }
+        }
+    }
+    return 1;
+}
+
+static void geo_data_quad_pending_free(geo_data_quad_pending *pending) {
+    free(pending->refs);
+    free(pending->segments);
+    pending->refs = NULL;
+    pending->segments = NULL;
+}
+
+static size_t geo_data_quad_pending_bytes(const geo_data_quad_pending *pending) {
+    return pending->num_refs * sizeof(geo_data_quad_ref) + pending->num_segments * sizeof(geo_data_segment);
+}
+
+static double geo_data_quad_eps(const geo_data_box *box) {
+    return fmax(box->max_lng - box->min_lng, box->max_lat - box->min_lat) * 1e-9;
+}
+
+// sets up the four children of parent without their buffers and counts the refs and segments each one will get,
+// returns the bytes they need so the build can check its cap before allocating. masks receives one bit per child
+// for every parent segment, the split reuses them
+static size_t geo_data_quad_split_count(const geo_data_quad_pending *parent, geo_data_quad_pending *children, uint8_t *masks,
+                                        unsigned int *num_refs, unsigned int *num_segments) {
+    double eps[4];
+    for(unsigned int q = 0; q < 4; ++q) {
+        geo_data_quad_pending *child = &children[q];
+        memset(child, 0, sizeof(geo_data_quad_pending));
+        geo_data_quad_child_box(&parent->box, q, &child->box);
+        child->depth = parent->depth + 1;
+        child->polygon = parent->polygon;
+        eps[q] = geo_data_quad_eps(&child->box);
+        num_refs[q] = num_segments[q] = 0;
+    }
+    
+    for(unsigned int r = 0; r < parent->num_refs; ++r) {
+        const geo_data_quad_ref *ref = &parent->refs[r];
+        unsigned int any = 0;
+        for(unsigned int i = ref->segments; i < ref->segments + ref->num_segments; ++i) {
+            unsigned int mask = 0;
+            for(unsigned int q = 0; q < 4; ++q) {
+                if(geo_data_segment_in_box(&parent->segments[i], &children[q].box, eps[q])) {
+                    mask |= 1u << q;
+                    num_segments[q]++;
+                }
+            }
+            masks[i] = (uint8_t)mask;
+            any |= mask;
+        }
+        for(unsigned int q = 0; q < 4; ++q) {
+            num_refs[q] += (any >> q) & 1;
+        }
+    }
+    
+    size_t bytes = 0;
+    for(unsigned int q = 0; q < 4; ++q) {
+        bytes += num_refs[q] * sizeof(geo_data_quad_ref) + num_segments[q] * sizeof(geo_data_segment);
+    }
+    return bytes;
+}
+
+// fills the children counted by geo_data_quad_split_count, deriving each child's reference state from the parent's
+// by counting the crossings between the two reference points
+static int geo_data_quad_split(const geo_data_quad_pending *parent, geo_data_quad_pending *children, const uint8_t *masks,
+                               const unsigned int *num_refs, const unsigned int *num_segments, int robust) {
+    geo_data_coordinate parent_ref;
+    geo_data_quad_ref_point(&parent->box, &parent_ref);
+    
+    for(unsigned int q = 0; q < 4; ++q) {
+        geo_data_quad_pending *child = &children[q];
+        child->refs = (geo_data_quad_ref *)malloc(sizeof(geo_data_quad_ref) * (num_refs[q] ? num_refs[q] : 1));
+        child->segments = (geo_data_segment *)malloc(sizeof(geo_data_segment) * (num_segments[q] ? num_segments[q] : 1));
+        if(!child->refs || !child->segments) {
+            for(unsigned int i = 0; i <= q; ++i) {
+                geo_data_quad_pending_free(&children[i]);
+            }
+            return -1;
+        }
+        
+        geo_data_coordinate child_ref;
+        geo_data_quad_ref_point(&child->box, &child_ref);
+        
+        for(unsigned int r = 0; r < parent->num_refs; ++r) {
+            const geo_data_quad_ref *ref = &parent->refs[r];
+            const geo_data_segment *segments = &parent->segments[ref->segments];
+            const uint8_t *ref_masks = &masks[ref->segments];
+            unsigned int inside = ref->inside;
+            unsigned int first = child->num_segments;
+            for(unsigned int i = 0; i < ref->num_segments; ++i) {
+                inside ^= geo_data_quad_crosses(&parent_ref, &child_ref, &segments[i], robust);
+                if((ref_masks[i] >> q) & 1) {
+                    child->segments[child->num_segments++] = segments[i];
+                }
+            }
+            if(child->num_segments > first) {
+                geo_data_quad_ref *child_ref_entry = &child->refs[child->num_refs++];
+                child_ref_entry->polygon = ref->polygon;
+                child_ref_entry->inside = inside;
+                child_ref_entry->segments = first;
+                child_ref_entry->num_segments = child->num_segments - first;
+            } else if(inside && (child->polygon < 0 || ref->polygon < (unsigned int)child->polygon)) {
+                child->polygon = (int)ref->polygon;
+            }
+        }
+    }
+    return 0;
+}
+
+// builds the quadtree level by level until every leaf holds at most quad_edges edges, reaches quad_depth or the
+// memory cap stops further splits. returns non zero when it could not be built within the cap.
+static int geo_data_quad_build(geo_data *data, const geo_data_options *options) {
+    unsigned int max_depth = options->quad_depth ? options->quad_depth : GEO_DATA_QUAD_DEPTH;
+    unsigned int max_edges = options->quad_edges ? options->quad_edges : GEO_DATA_QUAD_EDGES;
+    size_t max_bytes = options->quad_memory ? options->quad_memory : GEO_DATA_QUAD_MEMORY;
+    if(!data->grid.cells) {
+        return 0;
+    }
+    
+    geo_data_quad *quad = &data->quad;
+    memset(quad, 0, sizeof(geo_data_quad));
+    quad->extent = data->grid.extent;
+    unsigned int cap_nodes = 0, cap_refs = 0, cap_segments = 0, cap_queue = 0, cap_masks = 0;
+    geo_data_quad_pending *queue = NULL;
+    uint8_t *masks = NULL;
+    unsigned int head = 0, tail = 0;
+    int failed = 0;
+    
+    // root, every valid polygon with all of its edges
+    geo_data_quad_pending root;
+    memset(&root, 0, sizeof(geo_data_quad_pending));
+    root.box = quad->extent;
+    root.polygon = -1;
+    unsigned long long num_segments = 0;
+    for(unsigned int n = 0; n < data->num_polygons; ++n) {
+        if(data->boxes[n].min_lng <= data->boxes[n].max_lng) {
+            unsigned int num_coordinates;
+            geo_data_polygon(data, n, &num_coordinates);
+            num_segments += num_coordinates;
+        }
+    }
+    if(num_segments * sizeof(geo_data_segment) > max_bytes) {
+        return -1;
+    }
+    root.refs = (geo_data_quad_ref *)malloc(sizeof(geo_data_quad_ref) * (data->num_polygons ? data->num_polygons : 1));
+    root.segments = (geo_data_segment *)malloc(sizeof(geo_data_segment) * (num_segments ? num_segments : 1));
+    if(!root.refs || !root.segments) {
+        geo_data_quad_pending_free(&root);
+        return -1;
+    }
+    geo_data_coordinate root_ref;
+    geo_data_quad_ref_point(&root.box, &root_ref);
+    for(unsigned int n = 0; n < data->num_polygons; ++n) {
+        if(data->boxes[n].min_lng > data->boxes[n].max_lng) {
+            continue;
+        }
+        unsigned int num_coordinates;
+        geo_data_coordinate *coordinates = geo_data_polygon(data, n, &num_coordinates);
+        geo_data_quad_ref *ref = &root.refs[root.num_refs++];
+        ref->polygon = n;
+        ref->inside = geo_data_kernels[data->robust != 0][GEO_DATA_KERNEL_GENERIC](data, n, coordinates, num_coordinates,
+                                                                                   root_ref.lng, root_ref.lat);
+        ref->segments = root.num_segments;
+        ref->num_segments = num_coordinates;
+        for(unsigned int i = 0, j = num_coordinates - 1; i < num_coordinates; j = i++) {
+            root.segments[root.num_segments].a = coordinates[j];
+            root.segments[root.num_segments].b = coordinates[i];
+            root.num_segments++;
+        }
+    }
+    
+    if(geo_data_grow((void **)&quad->nodes, &cap_nodes, 1, sizeof(geo_data_quad_node)) ||
+       geo_data_grow((void **)&queue, &cap_queue, 1, sizeof(geo_data_quad_pending))) {
+        geo_data_quad_pending_free(&root);
+        free(queue);
+        free(quad->nodes);
+        quad->nodes = NULL;
+        return -1;
+    }
+    memset(&quad->nodes[0], 0, sizeof(geo_data_quad_node));
+    quad->num_nodes = 1;
+    queue[tail++] = root;
+    
+    size_t committed = sizeof(geo_data_quad_node);
+    size_t pending_bytes = geo_data_quad_pending_bytes(&root);
+    
+    while(head < tail) {
+        geo_data_quad_pending current = queue[head++];
+        size_t current_bytes = geo_data_quad_pending_bytes(&current);
+        
+        // children are counted before anything is allocated for them, so splits past the cap cost no memory
+        geo_data_quad_pending children[4];
+        unsigned int num_refs[4], num_segments[4];
+        int split = !failed && current.num_segments > max_edges && current.depth < max_depth &&
+                    !geo_data_grow((void **)&masks, &cap_masks, current.num_segments, sizeof(uint8_t));
+        size_t children_bytes = split ? geo_data_quad_split_count(&current, children, masks, num_refs, num_segments) : 0;
+        if(split && (committed + pending_bytes - current_bytes + children_bytes + 4 * sizeof(geo_data_quad_node) > max_bytes ||
+                     geo_data_grow((void **)&quad->nodes, &cap_nodes, quad->num_nodes + 4, sizeof(geo_data_quad_node)) ||
+                     geo_data_grow((void **)&queue, &cap_queue, tail + 4, sizeof(geo_data_quad_pending)) ||
+                     geo_data_quad_split(&current, children, masks, num_refs, num_segments, data->robust))) {
+            split = 0;
+        }
+        
+        geo_data_quad_node *node = &quad->nodes[current.node];
+        if(split) {
+            node->child = quad->num_nodes;
+            for(unsigned int q = 0; q < 4; ++q) {
+                memset(&quad->nodes[quad->num_nodes], 0, sizeof(geo_data_quad_node));
+                children[q].node = quad->num_nodes++;
+                queue[tail++] = children[q];
+            }
+            committed += 4 * sizeof(geo_data_quad_node);
+            pending_bytes += children_bytes - current_bytes;
+        } else {
+            node->polygon = current.polygon;
+            node->refs = quad->num_refs;
+            node->num_refs = current.num_refs;
+            if(geo_data_grow((void **)&quad->refs, &cap_refs, quad->num_refs + current.num_refs, sizeof(geo_data_quad_ref)) ||
+               geo_data_grow((void **)&quad->segments, &cap_segments, quad->num_segments + current.num_segments, sizeof(geo_data_segment))) {
+                failed = 1;
+            } else {
+                for(unsigned int r = 0; r < current.num_refs; ++r) {
+                    geo_data_quad_ref ref = current.refs[r];
+                    ref.segments += quad->num_segments;
+                    quad->refs[quad->num_refs++] = ref;
+                }
+                if(current.num_segments) {
+                    memcpy(&quad->segments[quad->num_segments], current.segments, sizeof(geo_data_segment) * current.num_segments);
+                }
+                quad->num_segments += current.num_segments;
+            }
+            committed += current_bytes;
+            pending_bytes -= current_bytes;
+        }
+        geo_data_quad_pending_free(&current);
+        
+        // compact the queue once its consumed head dominates
+        if(head > 1024 && head * 2 > tail) {
+            memmove(queue, queue + head, sizeof(geo_data_quad_pending) * (tail - head));
+            tail -= head;
+            head = 0;
+        }
+    }
+    free(queue);
+    free(masks);
+    
+    if(failed || committed > max_bytes) {
+        free(quad->nodes);
+        free(quad->refs);
+        free(quad->segments);
+        memset(quad, 0, sizeof(geo_data_quad));
+        return -1;
+    }
+    return 0;
+}
+
+// true when the segment a-b touches any polygon edge
+static int geo_data_segment_crosses(geo_data *data, const geo_data_coordinate *a, const geo_data_coordinate *b) {
+    if(!data->grid.cells) {
+        return 0;
+    }
+    // fixes are joined the short way around, across the antimeridian when that is shorter. the walk rejects copies of
+    // the segment outside the grid extent right away, so only datasets reaching past 180 pay for the other turns
+    geo_data_coordinate from = *a, to = *b;
+    to.lng += GEO_DATA_TURN * round((from.lng - to.lng) / GEO_DATA_TURN);
+    geo_data_grid_cross_ctx ctx;
+    ctx.polygons = data->polygons;
+    ctx.a = &from;
+    ctx.b = &to;
+    for(int t = 0; t < 3; ++t) {
+        double turn = t ? geo_data_turns[t] - geo_data_turns[t - 1] : 0.0;
+        from.lng += turn;
+        to.lng += turn;
+        if(geo_data_grid_walk(&data->grid, &from, &to, geo_data_grid_cross, &ctx)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// walks a polyline of interleaved lng/lat pairs and records the point indices where the containing polygon
+// changes, the first point is always recorded. indices and polygons need room for num_points entries.
+unsigned int geo_data_classify_track(geo_data *data, const double *coords, unsigned int num_points, unsigned int *indices, int *polygons);
+unsigned int geo_data_classify_track(geo_data *data, const double *coords, unsigned int num_points, unsigned int *indices, int *polygons) {
+    if(num_points == 0) {
+        return 0;
+    }
+    
+    data = geo_data_local(data);
+    const geo_data_coordinate *points = (const geo_data_coordinate *)coords;
+    int current = geo_data_lookup(data, points[0].lng, points[0].lat);
+    unsigned int count = 0;
+    indices[count] = 0;
+    polygons[count] = current;
+    ++count;
+    
+    for(unsigned int i = 1; i < num_points; ++i) {
+        const geo_data_coordinate *a = &points[i - 1];
+        const geo_data_coordinate *b = &points[i];
+        
+        // without an edge or the domain border between the two fixes the containing polygon can not change
+        if(data && isfinite(a->lng) && isfinite(a->lat) && isfinite(b->lng) && isfinite(b->lat) &&
+           geo_data_in_domain(data, a->lng, a->lat) == geo_data_in_domain(data, b->lng, b->lat) && !geo_data_segment_crosses(data, a, b)) {
+            continue;
+        }
+        
+        int next = geo_data_lookup(data, b->lng, b->lat);
+        if(next != current) {
+            indices[count] = i;
+            polygons[count] = next;
+            ++count;
+            current = next;
+        }
+    }
+    return count;
+}
+
+// DISTANCE
+
+#define GEO_DATA_EARTH_RADIUS 6371008.8 // mean radius in meters
+#define GEO_DATA_METERS_PER_DEGREE (GEO_DATA_EARTH_RADIUS * M_PI / 180.0)
+
+// squared distance from p to the segment a-b, all in the same planar units
+static inline double geo_data_segment_distance2(double px, double py, double ax, double ay, double bx, double by) {
+    double dx = bx - ax, dy = by - ay;
+    double len2 = dx * dx + dy * dy;
+    double t = len2 > 0.0 ? ((px - ax) * dx + (py - ay) * dy) / len2 : 0.0;
+    t = t < 0.0 ? 0.0 : (t > 1.0 ? 1.0 : t);
+    double ex = ax + t * dx - px, ey = ay + t * dy - py;
+    return ex * ex + ey * ey;
+}
+
+typedef struct {
+    double best; // squared, in lat degrees
+    unsigned int polygon;
+    uint64_t from;
+} geo_data_distance_best;
+
+// branch and bound over the edge grid: rings of cells around the point's cell are searched until every unvisited cell
+// is farther away than the best edge so far
+static void geo_data_distance_search(const geo_data *data, double lng, double lat, double kx, geo_data_distance_best *found) {
+    const geo_data_grid *grid = &data->grid;
+    double px = lng * kx;
+    
+    int c0 = (int)geo_data_grid_clamp((lng - grid->extent.min_lng) / grid->cell_lng, grid->cols);
+    int r0 = (int)geo_data_grid_clamp((lat - grid->extent.min_lat) / grid->cell_lat, grid->rows);
+    double best = found->best;
+    unsigned int best_polygon = found->polygon;
+    uint64_t best_from = found->from;
+    
+    for(int k = 0;; ++k) {
+        for(int r = r0 - k; r <= r0 + k; ++r) {
+            if(r < 0 || r >= (int)grid->rows) {
+                continue;
+            }
+            // the full row on the ring's top and bottom, its two ends otherwise
+            int step = (r == r0 - k || r == r0 + k) ? 1 : 2 * k;
+            for(int c = c0 - k; c <= c0 + k; c += step ? step : 1) {
+                if(c < 0 || c >= (int)grid->cols) {
+                    continue;
+                }
+                double min_lng = grid->extent.min_lng + c * grid->cell_lng;
+                double min_lat = grid->extent.min_lat + r * grid->cell_lat;
+                double gx = fmax(fmax(min_lng - lng, lng - (min_lng + grid->cell_lng)), 0.0) * kx;
+                double gy = fmax(fmax(min_lat - lat, lat - (min_lat + grid->cell_lat)), 0.0);
+                if(gx * gx + gy * gy > best) {
+                    continue;
+                }
+                unsigned int cell = r * grid->cols + c;
+                for(unsigned int e = grid->cells[cell]; e < grid->cells[cell + 1]; ++e) {
+                    const geo_data_edge *edge = &grid->edges[e];
+                    const geo_data_coordinate *a = (const geo_data_coordinate *)(data->polygons + edge->from);
+                    const geo_data_coordinate *b = (const geo_data_coordinate *)(data->polygons + edge->to);
+                    double d = geo_data_segment_distance2(px, lat, a->lng * kx, a->lat, b->lng * kx, b->lat);
+                    // edges repeat across cells, ties go to the lowest polygon and edge so the answer is stable
+                    if(d < best || (d == best && (edge->polygon < best_polygon || (edge->polygon == best_polygon && edge->from < best_from)))) {
+                        best = d;
+                        best_polygon = edge->polygon;
+                        best_from = edge->from;
+                    }
+                }
+            }
+        }
+        
+        // every cell outside the searched square lies beyond one of its sides that isn't the grid border
+        int left = c0 - k > 0, right = c0 + k < (int)grid->cols - 1;
+        int bottom = r0 - k > 0, top = r0 + k < (int)grid->rows - 1;
+        if(!left && !right && !bottom && !top) {
+            break;
+        }
+        double bound = DBL_MAX;
+        if(left) {
+            bound = fmin(bound, fmax(lng - (grid->extent.min_lng + (c0 - k) * grid->cell_lng), 0.0) * kx);
+        }
+        if(right) {
+            bound = fmin(bound, fmax(grid->extent.min_lng + (c0 + k + 1) * grid->cell_lng - lng, 0.0) * kx);
+        }
+        if(bottom) {
+            bound = fmin(bound, fmax(lat - (grid->extent.min_lat + (r0 - k) * grid->cell_lat), 0.0));
+        }
+        if(top) {
+            bound = fmin(bound, fmax(grid->extent.min_lat + (r0 + k + 1) * grid->cell_lat - lat, 0.0));
+        }
+        if(best < DBL_MAX && bound * bound > best) {
+            break;
+        }
+    }
+    
+    found->best = best;
+    found->polygon = best_polygon;
+    found->from = best_from;
+}
+
+// nearest polygon edge to a point. distances are equirectangular around the point's latitude, which is accurate well
+// beyond the few kilometers geofencing cares about, and wrap around the antimeridian
+void geo_data_distance_to_boundary(geo_data *data, double lng, double lat, geo_data_distance *result);
+void geo_data_distance_to_boundary(geo_data *data, double lng, double lat, geo_data_distance *result) {
+    result->meters = HUGE_VAL;
+    result->polygon = -1;
+    result->edge = 0;
+    data = geo_data_local(data);
+    if(!data || !data->grid.cells || !data->grid.edges) {
+        return;
+    }
+    double kx = cos(lat * M_PI / 180.0); // lng degrees to lat degrees at the point
+    geo_data_distance_best found;
+    found.best = DBL_MAX;
+    found.polygon = 0;
+    found.from = 0;
+    
+    // the point itself first, then its copies one turn east and west where the grid extent comes close enough
+    const geo_data_box *extent = &data->grid.extent;
+    for(int t = 0; t < 3; ++t) {
+        double shifted = lng + geo_data_turns[t];
+        double gx = fmax(fmax(extent->min_lng - shifted, shifted - extent->max_lng), 0.0) * kx;
+        double gy = fmax(fmax(extent->min_lat - lat, lat - extent->max_lat), 0.0);
+        if(t == 0 || gx * gx + gy * gy <= found.best) {
+            geo_data_distance_search(data, shifted, lat, kx, &found);
+        }
+    }
+    
+    if(found.best < DBL_MAX) {
+        result->meters = sqrt(found.best) * GEO_DATA_METERS_PER_DEGREE;
+        result->polygon = (int)found.polygon;
+        result->edge = (unsigned int)((found.from - data->offsets[found.polygon] - sizeof(unsigned int)) / sizeof(geo_data_coordinate));
+    }
+}
+
+// RTREE
+
+#define GEO_DATA_RTREE_FANOUT 16
+
+typedef struct {
+    geo_data_box box;
+    unsigned int id;
+} geo_data_rtree_entry;
+
+static int geo_data_rtree_compare_lng(const void *a, const void *b) {
+    const geo_data_box *x = &((const geo_data_rtree_entry *)a)->box, *y = &((const geo_data_rtree_entry *)b)->box;
+    double cx = x->min_lng + x->max_lng, cy = y->min_lng + y->max_lng;
+    return cx < cy ? -1 : cx > cy;
+}
+
+static int geo_data_rtree_compare_lat(const void *a, const void *b) {
+    const geo_data_box *x = &((const geo_data_rtree_entry *)a)->box, *y = &((const geo_data_rtree_entry *)b)->box;
+    double cx = x->min_lat + x->max_lat, cy = y->min_lat + y->max_lat;
+    return cx < cy ? -1 : cx > cy;
+}
+
+// sort tile recursive order: vertical slices by center lng, each slice by center lat, so consecutive runs of
+// GEO_DATA_RTREE_FANOUT entries form compact nodes
+static void geo_data_rtree_str(geo_data_rtree_entry *entries, unsigned int num_entries) {
+    unsigned int num_nodes = (num_entries + GEO_DATA_RTREE_FANOUT - 1) / GEO_DATA_RTREE_FANOUT;
+    unsigned int num_slices = (unsigned int)ceil(sqrt((double)num_nodes));
+    unsigned int slice = num_slices * GEO_DATA_RTREE_FANOUT;
+    qsort(entries, num_entries, sizeof(geo_data_rtree_entry), geo_data_rtree_compare_lng);
+    for(unsigned int i = 0; i < num_entries; i += slice) {
+        qsort(&entries[i], num_entries - i < slice ? num_entries - i : slice, sizeof(geo_data_rtree_entry), geo_data_rtree_compare_lat);
+    }
+}
+
+// packs the valid polygons bottom up, returns -1 when memory runs out
+static int geo_data_rtree_build(geo_data *data) {
+    geo_data_rtree *rtree = &data->rtree;
+    memset(rtree, 0, sizeof(geo_data_rtree));
+    unsigned int num_entries = 0;
+    for(unsigned int n = 0; n < data->num_polygons; ++n) {
+        num_entries += data->boxes[n].min_lng <= data->boxes[n].max_lng;
+    }
+    if(!num_entries) {
+        return 0;
+    }
+    
+    // every level has at most a FANOUT-th of the entries below it
+    unsigned int cap_nodes = 0;
+    for(unsigned int count = num_entries; count > 1;) {
+        count = (count + GEO_DATA_RTREE_FANOUT - 1) / GEO_DATA_RTREE_FANOUT;
+        cap_nodes += count;
+    }
+    cap_nodes += 1;
+    geo_data_rtree_entry *entries = (geo_data_rtree_entry *)malloc(sizeof(geo_data_rtree_entry) * num_entries);
+    rtree->items = (unsigned int *)malloc(sizeof(unsigned int) * num_entries);
+    rtree->nodes = (geo_data_rtree_node *)malloc(sizeof(geo_data_rtree_node) * cap_nodes);
+    if(!entries || !rtree->items || !rtree->nodes) {
+        free(entries);
+        free(rtree->items);
+        free(rtree->nodes);
+        memset(rtree, 0, sizeof(geo_data_rtree));
+        return -1;
+    }
+    
+    unsigned int count = 0;
+    for(unsigned int n = 0; n < data->num_polygons; ++n) {
+        if(data->boxes[n].min_lng <= data->boxes[n].max_lng) {
+            entries[count].box = data->boxes[n];
+            entries[count].id = n;
+            ++count;
+        }
+    }
+    geo_data_rtree_str(entries, count);
+    for(unsigned int i = 0; i < count; ++i) {
+        rtree->items[i] = entries[i].id;
+    }
+    rtree->num_items = count;
+    
+    // each pass turns the entries into the next level's nodes and their boxes into the entries above
+    int leaf = 1;
+    do {
+        unsigned int level = rtree->num_nodes, num_parents = 0;
+        for(unsigned int i = 0; i < count; i += GEO_DATA_RTREE_FANOUT) {
+            geo_data_rtree_node *node = &rtree->nodes[rtree->num_nodes++];
+            node->first = leaf ? i : entries[i].id;
+            node->count = (unsigned short)(count - i < GEO_DATA_RTREE_FANOUT ? count - i : GEO_DATA_RTREE_FANOUT);
+            node->leaf = (unsigned short)leaf;
+            node->box = entries[i].box;
+            for(unsigned int j = 1; j < node->count; ++j) {
+                const geo_data_box *box = &entries[i + j].box;
+                node->box.min_lng = fmin(node->box.min_lng, box->min_lng);
+                node->box.min_lat = fmin(node->box.min_lat, box->min_lat);
+                node->box.max_lng = fmax(node->box.max_lng, box->max_lng);
+                node->box.max_lat = fmax(node->box.max_lat, box->max_lat);
+            }
+            ++num_parents;
+        }
+        // children have to stay consecutive, so the new level is tiled and then stored in that order
+        count = num_parents;
+        for(unsigned int i = 0; i < count; ++i) {
+            entries[i].box = rtree->nodes[level + i].box;
+            entries[i].id = level + i;
+        }
+        if(count > 1) {
+            geo_data_rtree_str(entries, count);
+            geo_data_rtree_node *sorted = (geo_data_rtree_node *)malloc(sizeof(geo_data_rtree_node) * count);
+            if(!sorted) {
+                free(entries);
+                free(rtree->items);
+                free(rtree->nodes);
+                memset(rtree, 0, sizeof(geo_data_rtree));
+                return -1;
+            }
+            for(unsigned int i = 0; i < count; ++i) {
+                sorted[i] = rtree->nodes[entries[i].id];
+                entries[i].id = level + i;
+            }
+            memcpy(&rtree->nodes[level], sorted, sizeof(geo_data_rtree_node) * count);
+            free(sorted);
+        }
+        leaf = 0;
+    } while(count > 1);
+    
+    free(entries);
+    return 0;
+}
+
+// squared distance from the point to a box in the query's equirectangular frame, kx scales lng degrees
+static inline double geo_data_box_distance2(const geo_data_box *box, double lng, double lat, double kx) {
+    double gx = DBL_MAX;
+    for(int t = 0; t < 3; ++t) {
+        gx = fmin(gx, fmax(fmax(box->min_lng - (lng + geo_data_turns[t]), lng + geo_data_turns[t] - box->max_lng), 0.0));
+    }
+    gx *= kx;
+    double gy = fmax(fmax(box->min_lat - lat, lat - box->max_lat), 0.0);
+    return gx * gx + gy * gy;
+}
+
+// squared distance from the point to polygon n, 0 inside it
+static double geo_data_polygon_distance2(const geo_data *data, unsigned int n, double lng, double lat, double kx) {
+    if(geo_data_hit_test_polygon(data, n, lng, lat)) {
+        return 0.0;
+    }
+    unsigned int num_coordinates;
+    const geo_data_coordinate *coordinates = geo_data_polygon(data, n, &num_coordinates);
+    double best = DBL_MAX;
+    for(int t = 0; t < 3; ++t) {
+        // copies of the point farther from the box than the best edge so far can't improve on it
+        double gx = fmax(fmax(data->boxes[n].min_lng - (lng + geo_data_turns[t]), lng + geo_data_turns[t] - data->boxes[n].max_lng), 0.0) * kx;
+        double gy = fmax(fmax(data->boxes[n].min_lat - lat, lat - data->boxes[n].max_lat), 0.0);
+        if(gx * gx + gy * gy > best) {
+            continue;
+        }
+        double px = (lng + geo_data_turns[t]) * kx;
+        for(unsigned int i = 0, j = num_coordinates - 1; i < num_coordinates; j = i++) {
+            double d = geo_data_segment_distance2(px, lat, coordinates[j].lng * kx, coordinates[j].lat,
+                                                  coordinates[i].lng * kx, coordinates[i].lat);
+            best = fmin(best, d);
+        }
+    }
+    return best;
+}
+
+// best first queue entry: a node, a polygon keyed by its box or a polygon keyed by its exact distance
+typedef struct {
+    double key;
+    unsigned int id;
+    unsigned int kind;
+} geo_data_rtree_pending;
+
+#define GEO_DATA_RTREE_NODE 0
+#define GEO_DATA_RTREE_BOX 1
+#define GEO_DATA_RTREE_EXACT 2
+
+static int geo_data_rtree_push(geo_data_rtree_pending **heap, unsigned int *len, unsigned int *cap, double key, unsigned int id,
+                               unsigned int kind) {
+    if(*len == *cap) {
+        unsigned int cap_next = *cap ? *cap * 2 : 64;
+        geo_data_rtree_pending *grown = (geo_data_rtree_pending *)realloc(*heap, sizeof(geo_data_rtree_pending) * cap_next);
+        if(!grown) {
+            return -1;
+        }
+        *heap = grown;
+        *cap = cap_next;
+    }
+    // sift up, ties go to exact distances first so equal keys resolve in a fixed order
+    unsigned int i = (*len)++;
+    geo_data_rtree_pending entry = {key, id, kind};
+    while(i > 0) {
+        geo_data_rtree_pending *parent = &(*heap)[(i - 1) / 2];
+        if(parent->key < key || (parent->key == key && (parent->kind > kind || (parent->kind == kind && parent->id <= id)))) {
+            break;
+        }
+        (*heap)[i] = *parent;
+        i = (i - 1) / 2;
+    }
+    (*heap)[i] = entry;
+    return 0;
+}
+
+static geo_data_rtree_pending geo_data_rtree_pop(geo_data_rtree_pending *heap, unsigned int *len) {
+    geo_data_rtree_pending top = heap[0];
+    geo_data_rtree_pending last = heap[--(*len)];
+    unsigned int i = 0;
+    for(;;) {
+        unsigned int child = 2 * i + 1;
+        if(child >= *len) {
+            break;
+        }
+        if(child + 1 < *len) {
+            const geo_data_rtree_pending *a = &heap[child], *b = &heap[child + 1];
+            if(b->key < a->key || (b->key == a->key && (b->kind > a->kind || (b->kind == a->kind && b->id < a->id)))) {
+                ++child;
+            }
+        }
+        const geo_data_rtree_pending *c = &heap[child];
+        if(last.key < c->key || (last.key == c->key && (last.kind > c->kind || (last.kind == c->kind && last.id <= c->id)))) {
+            break;
+        }
+        heap[i] = *c;
+        i = child;
+    }
+    heap[i] = last;
+    return top;
+}
+
+// k nearest polygons to a point, closest first, a polygon containing the point is 0 meters away. returns how many were
+// found, at most k and fewer when the dataset holds fewer valid polygons, or -1 when memory runs out
+int geo_data_nearest(geo_data *data, double lng, double lat, unsigned int k, int *polygons, double *meters);
+int geo_data_nearest(geo_data *data, double lng, double lat, unsigned int k, int *polygons, double *meters) {
+    data = geo_data_local(data);
+    if(!data || !data->rtree.num_nodes || k == 0) {
+        return 0;
+    }
+    const geo_data_rtree *rtree = &data->rtree;
+    double kx = cos(lat * M_PI / 180.0);
+    
+    geo_data_rtree_pending *heap = NULL;
+    unsigned int len = 0, cap = 0, found = 0;
+    unsigned int root = rtree->num_nodes - 1;
+    int failed = geo_data_rtree_push(&heap, &len, &cap, geo_data_box_distance2(&rtree->nodes[root].box, lng, lat, kx), root,
+                                     GEO_DATA_RTREE_NODE);
+    while(!failed && len && found < k) {
+        geo_data_rtree_pending top = geo_data_rtree_pop(heap, &len);
+        if(top.kind == GEO_DATA_RTREE_EXACT) {
+            // nothing left in the queue can be closer than its key
+            polygons[found] = (int)top.id;
+            meters[found] = sqrt(top.key) * GEO_DATA_METERS_PER_DEGREE;
+            ++found;
+        } else if(top.kind == GEO_DATA_RTREE_BOX) {
+            failed = geo_data_rtree_push(&heap, &len, &cap, geo_data_polygon_distance2(data, top.id, lng, lat, kx), top.id,
+                                         GEO_DATA_RTREE_EXACT);
+        } else {
+            const geo_data_rtree_node *node = &rtree->nodes[top.id];
+            for(unsigned int i = 0; i < node->count && !failed; ++i) {
+                if(node->leaf) {
+                    unsigned int n = rtree->items[node->first + i];
+                    failed = geo_data_rtree_push(&heap, &len, &cap, geo_data_box_distance2(&data->boxes[n], lng, lat, kx), n,
+                                                 GEO_DATA_RTREE_BOX);
+                } else {
+                    unsigned int child = node->first + i;
+                    failed = geo_data_rtree_push(&heap, &len, &cap, geo_data_box_distance2(&rtree->nodes[child].box, lng, lat, kx),
+                                                 child, GEO_DATA_RTREE_NODE);
+                }
+            }
+        }
+    }
+    free(heap);
+    return failed ? -1 : (int)found;
+}
+
+// polygons whose boxes pass filter down the tree and then refine, ascending. *results is malloc'ed, free it after use.
+// returns -1 when memory runs out
+typedef int (*geo_data_rtree_filter)(const geo_data *data, const geo_data_box *box, const void *ctx);
+typedef int (*geo_data_rtree_refine)(const geo_data *data, unsigned int n, const void *ctx);
+
+static int geo_data_compare_uints(const void *a, const void *b) {
+    unsigned int x = *(const unsigned int *)a, y = *(const unsigned int *)b;
+    return x < y ? -1 : x > y;
+}
+
+static int geo_data_rtree_search(const geo_data *data, geo_data_rtree_filter filter, geo_data_rtree_refine refine, const void *ctx,
+                                 unsigned int **results, unsigned int *num_results) {
+    *results = NULL;
+    *num_results = 0;
+    const geo_data_rtree *rtree = &data->rtree;
+    if(!rtree->num_nodes) {
+        return 0;
+    }
+    unsigned int cap = 0;
+    // a path holds at most FANOUT pending siblings per level and 32 bit indices need fewer than 9 levels
+    unsigned int stack[GEO_DATA_RTREE_FANOUT * 9 + 1];
+    unsigned int top = 0;
+    stack[top++] = rtree->num_nodes - 1;
+    while(top) {
+        const geo_data_rtree_node *node = &rtree->nodes[stack[--top]];
+        if(!filter(data, &node->box, ctx)) {
+            continue;
+        }
+        for(unsigned int i = 0; i < node->count; ++i) {
+            if(!node->leaf) {
+                stack[top++] = node->first + i;
+                continue;
+            }
+            unsigned int n = rtree->items[node->first + i];
+            if(!filter(data, &data->boxes[n], ctx) || (refine && !refine(data, n, ctx))) {
+                continue;
+            }
+            if(*num_results == cap) {
+                unsigned int cap_next = cap ? cap * 2 : 64;
+                unsigned int *grown = (unsigned int *)realloc(*results, sizeof(unsigned int) * cap_next);
+                if(!grown) {
+                    free(*results);
+                    *results = NULL;
+                    *num_results = 0;
+                    return -1;
+                }
+                *results = grown;
+                cap = cap_next;
+            }
+            (*results)[(*num_results)++] = n;
+        }
+    }
+    qsort(*results, *num_results, sizeof(unsigned int), geo_data_compare_uints);
+    return 0;
+}
+
+// overlap with the query box or its copy one turn east or west
+static inline int geo_data_box_overlaps_turn(const geo_data_box *box, const geo_data_box *query, double turn) {
+    return box->min_lng <= query->max_lng + turn && box->max_lng >= query->min_lng + turn && box->min_lat <= query->max_lat &&
+           box->max_lat >= query->min_lat;
+}
+
+static int geo_data_query_box_filter(const geo_data *data, const geo_data_box *box, const void *ctx) {
+    (void)data;
+    const geo_data_box *query = (const geo_data_box *)ctx;
+    for(int t = 0; t < 3; ++t) {
+        if(geo_data_box_overlaps_turn(box, query, geo_data_turns[t])) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// an edge touches the box or, with none touching, any point of the box decides for all of it
+static int geo_data_query_box_refine(const geo_data *data, unsigned int n, const void *ctx) {
+    const geo_data_box *query = (const geo_data_box *)ctx;
+    unsigned int num_coordinates;
+    const geo_data_coordinate *coordinates = geo_data_polygon(data, n, &num_coordinates);
+    for(int t = 0; t < 3; ++t) {
+        if(!geo_data_box_overlaps_turn(&data->boxes[n], query, geo_data_turns[t])) {
+            continue;
+        }
+        geo_data_box shifted = *query;
+        shifted.min_lng += geo_data_turns[t];
+        shifted.max_lng += geo_data_turns[t];
+        for(unsigned int i = 0, j = num_coordinates - 1; i < num_coordinates; j = i++) {
+            geo_data_segment segment;
+            segment.a = coordinates[j];
+            segment.b = coordinates[i];
+            if(geo_data_segment_in_box(&segment, &shifted, 0.0)) {
+                return 1;
+            }
+        }
+        if(geo_data_hit_test_polygon(data, n, shifted.min_lng, shifted.min_lat)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// polygons intersecting the box, by their boxes alone unless exact. a box with min_lng above max_lng crosses the
+// antimeridian, i.e. runs east from min_lng to max_lng + 360
+int geo_data_query_box(geo_data *data, const geo_data_box *box, int exact, unsigned int **results, unsigned int *num_results);
+int geo_data_query_box(geo_data *data, const geo_data_box *box, int exact, unsigned int **results, unsigned int *num_results) {
+    *results = NULL;
+    *num_results = 0;
+    data = geo_data_local(data);
+    if(!data || !(box->min_lat <= box->max_lat) || !(box->min_lng <= box->max_lng + GEO_DATA_TURN)) {
+        return 0;
+    }
+    geo_data_box query = *box;
+    if(query.min_lng > query.max_lng) {
+        query.max_lng += GEO_DATA_TURN;
+    }
+    return geo_data_rtree_search(data, geo_data_query_box_filter, exact ? geo_data_query_box_refine : NULL, &query, results,
+                                 num_results);
+}
+
+typedef struct {
+    double lng;
+    double lat;
+    double kx;
+    double radius2; // squared, in lat degrees
+} geo_data_query_radius_ctx;
+
+static int geo_data_query_radius_filter(const geo_data *data, const geo_data_box *box, const void *ctx) {
+    (void)data;
+    const geo_data_query_radius_ctx *query = (const geo_data_query_radius_ctx *)ctx;
+    return geo_data_box_distance2(box, query->lng, query->lat, query->kx) <= query->radius2;
+}
+
+static int geo_data_query_radius_refine(const geo_data *data, unsigned int n, const void *ctx) {
+    const geo_data_query_radius_ctx *query = (const geo_data_query_radius_ctx *)ctx;
+    return geo_data_polygon_distance2(data, n, query->lng, query->lat, query->kx) <= query->radius2;
+}
+
+// polygons within meters of the point, by their boxes alone unless exact
+int geo_data_query_radius(geo_data *data, double lng, double lat, double meters, int exact, unsigned int **results,
+                          unsigned int *num_results);
+int geo_data_query_radius(geo_data *data, double lng, double lat, double meters, int exact, unsigned int **results,
+                          unsigned int *num_results) {
+    *results = NULL;
+    *num_results = 0;
+    data = geo_data_local(data);
+    if(!data || !(meters >= 0.0)) {
+        return 0;
+    }
+    geo_data_query_radius_ctx query;
+    query.lng = lng;
+    query.lat = lat;
+    query.kx = cos(lat * M_PI / 180.0);
+    query.radius2 = (meters / GEO_DATA_METERS_PER_DEGREE) * (meters / GEO_DATA_METERS_PER_DEGREE);
+    return geo_data_rtree_search(data, geo_data_query_radius_filter, exact ? geo_data_query_radius_refine : NULL, &query, results,
+                                 num_results);
+}
+
+// RINGS
+
+typedef struct {
+    geo_data_box box;
+    const geo_data_coordinate *a;
+    const geo_data_coordinate *b;
+} geo_data_sweep_edge;
+
+static int geo_data_sweep_compare(const void *a, const void *b) {
+    double x = ((const geo_data_sweep_edge *)a)->box.min_lng, y = ((const geo_data_sweep_edge *)b)->box.min_lng;
+    return x < y ? -1 : x > y;
+}
+
+static inline void geo_data_sweep_edge_init(geo_data_sweep_edge *edge, const geo_data_coordinate *a, const geo_data_coordinate *b) {
+    edge->a = a;
+    edge->b = b;
+    edge->box.min_lng = fmin(a->lng, b->lng);
+    edge->box.max_lng = fmax(a->lng, b->lng);
+    edge->box.min_lat = fmin(a->lat, b->lat);
+    edge->box.max_lat = fmax(a->lat, b->lat);
+}
+
+// sweep and prune over two edge sets sorted by min lng: every edge entering the sweep is tested against the other
+// set's edges still open at its lng, so only pairs overlapping in lng and lat reach the segment test
+static int geo_data_sweep_intersects(const geo_data_sweep_edge *a, unsigned int num_a, const geo_data_sweep_edge *b, unsigned int num_b,
+                                     unsigned int *active_a, unsigned int *active_b) {
+    unsigned int i = 0, j = 0, num_active_a = 0, num_active_b = 0;
+    while(i < num_a || j < num_b) {
+        int from_a = j >= num_b || (i < num_a && a[i].box.min_lng <= b[j].box.min_lng);
+        const geo_data_sweep_edge *edge = from_a ? &a[i] : &b[j];
+        const geo_data_sweep_edge *others = from_a ? b : a;
+        unsigned int *active = from_a ? active_b : active_a;
+        unsigned int *num_active = from_a ? &num_active_b : &num_active_a;
+        for(unsigned int k = 0; k < *num_active;) {
+            const geo_data_sweep_edge *other = &others[active[k]];
+            if(other->box.max_lng < edge->box.min_lng) {
+                active[k] = active[--(*num_active)];
+                continue;
+            }
+            if(other->box.min_lat <= edge->box.max_lat && other->box.max_lat >= edge->box.min_lat &&
+               geo_data_segments_intersect(edge->a, edge->b, other->a, other->b)) {
+                return 1;
+            }
+            ++k;
+        }
+        if(from_a) {
+            active_a[num_active_a++] = i++;
+        } else {
+            active_b[num_active_b++] = j++;
+        }
+    }
+    return 0;
+}
+
+typedef struct {
+    geo_data_box box; // first, the box filter reads the context as the ring's box
+    geo_data_coordinate *rings[3]; // the unwrapped ring and its copies per geo_data_turns
+    unsigned int num_points;
+    int mode;
+    geo_data_sweep_edge *ring_edges[3]; // per copy, sorted by min lng
+    unsigned int num_ring_edges;
+    // scratch, grown as polygons need it
+    geo_data_sweep_edge *edges;
+    unsigned int *active;
+    unsigned int cap;
+    int failed;
+} geo_data_ring_query;
+
+static int geo_data_ring_refine(const geo_data *data, unsigned int n, const void *ctx) {
+    geo_data_ring_query *query = (geo_data_ring_query *)ctx;
+    unsigned int num_coordinates;
+    const geo_data_coordinate *coordinates = geo_data_polygon(data, n, &num_coordinates);
+    if(num_coordinates + query->num_ring_edges > query->cap) {
+        unsigned int cap = num_coordinates + query->num_ring_edges;
+        geo_data_sweep_edge *edges = (geo_data_sweep_edge *)realloc(query->edges, sizeof(geo_data_sweep_edge) * cap);
+        if(edges) {
+            query->edges = edges;
+        }
+        unsigned int *active = (unsigned int *)realloc(query->active, sizeof(unsigned int) * cap);
+        if(active) {
+            query->active = active;
+        }
+        if(!edges || !active) {
+            query->failed = 1;
+            return 0;
+        }
+        query->cap = cap;
+    }
+    
+    // every copy of the ring reaching the polygon's box is tested, across the antimeridian that is at most two of them
+    int matched = 0;
+    for(int t = 0; t < 3 && !matched; ++t) {
+        if(!geo_data_box_overlaps_turn(&data->boxes[n], &query->box, geo_data_turns[t])) {
+            continue;
+        }
+        const geo_data_coordinate *ring = query->rings[t];
+        geo_data_box box = query->box;
+        box.min_lng += geo_data_turns[t];
+        box.max_lng += geo_data_turns[t];
+        
+        // only polygon edges reaching into the ring's box can meet the ring
+        unsigned int num_edges = 0;
+        for(unsigned int i = 0, j = num_coordinates - 1; i < num_coordinates; j = i++) {
+            geo_data_sweep_edge *edge = &query->edges[num_edges];
+            geo_data_sweep_edge_init(edge, &coordinates[j], &coordinates[i]);
+            num_edges += edge->box.min_lng <= box.max_lng && edge->box.max_lng >= box.min_lng && edge->box.min_lat <= box.max_lat &&
+                         edge->box.max_lat >= box.min_lat;
+        }
+        qsort(query->edges, num_edges, sizeof(geo_data_sweep_edge), geo_data_sweep_compare);
+        int touching = geo_data_sweep_intersects(query->edges, num_edges, query->ring_edges[t], query->num_ring_edges, query->active,
+                                                 query->active + num_edges);
+        
+        // without touching boundaries one is inside the other or they are apart, a single vertex of each decides
+        int ring_inside = geo_data_hit_test_polygon(data, n, ring[0].lng, ring[0].lat);
+        if(query->mode == GEO_DATA_RING_WITHIN) {
+            matched = !touching && ring_inside;
+        } else {
+            matched = touching || ring_inside ||
+                      geo_data_polygon_hit_test(ring, query->num_points, coordinates[0].lng, coordinates[0].lat);
+        }
+    }
+    return matched;
+}
+
+// polygons meeting a ring of lng/lat pairs per mode, GEO_DATA_RING_*, ascending. *results is malloc'ed, free it after use.
+// rings with fewer than 3 points or non finite coordinates match nothing, rings crossing the antimeridian are unwrapped
+// like stored polygons. returns -1 when memory runs out
+int geo_data_query_ring(geo_data *data, const double *coords, unsigned int num_points, int mode, unsigned int **results,
+                        unsigned int *num_results);
+int geo_data_query_ring(geo_data *data, const double *coords, unsigned int num_points, int mode, unsigned int **results,
+                        unsigned int *num_results) {
+    *results = NULL;
+    *num_results = 0;
+    data = geo_data_local(data);
+    if(!data || num_points < 3) {
+        return 0;
+    }
+    
+    for(unsigned int i = 0; i < num_points * 2; ++i) {
+        if(!isfinite(coords[i])) {
+            return 0;
+        }
+    }
+    
+    geo_data_ring_query query;
+    memset(&query, 0, sizeof(geo_data_ring_query));
+    query.num_points = num_points;
+    query.mode = mode;
+    query.rings[0] = (geo_data_coordinate *)malloc(sizeof(geo_data_coordinate) * num_points * 3);
+    query.ring_edges[0] = (geo_data_sweep_edge *)malloc(sizeof(geo_data_sweep_edge) * num_points * 3);
+    if(!query.rings[0] || !query.ring_edges[0]) {
+        free(query.rings[0]);
+        free(query.ring_edges[0]);
+        return -1;
+    }
+    memcpy(query.rings[0], coords, sizeof(geo_data_coordinate) * num_points);
+    geo_data_unwrap(query.rings[0], num_points);
+    query.box.min_lng = query.box.min_lat = DBL_MAX;
+    query.box.max_lng = query.box.max_lat = -DBL_MAX;
+    for(unsigned int i = 0; i < num_points; ++i) {
+        query.box.min_lng = fmin(query.box.min_lng, query.rings[0][i].lng);
+        query.box.min_lat = fmin(query.box.min_lat, query.rings[0][i].lat);
+        query.box.max_lng = fmax(query.box.max_lng, query.rings[0][i].lng);
+        query.box.max_lat = fmax(query.box.max_lat, query.rings[0][i].lat);
+    }
+    
+    for(int t = 0; t < 3; ++t) {
+        geo_data_coordinate *ring = query.rings[t] = query.rings[0] + num_points * t;
+        geo_data_sweep_edge *edges = query.ring_edges[t] = query.ring_edges[0] + num_points * t;
+        for(unsigned int i = 0; i < num_points; ++i) {
+            ring[i].lng = query.rings[0][i].lng + geo_data_turns[t];
+            ring[i].lat = query.rings[0][i].lat;
+        }
+        for(unsigned int i = 0, j = num_points - 1; i < num_points; j = i++) {
+            geo_data_sweep_edge_init(&edges[i], &ring[j], &ring[i]);
+        }
+        qsort(edges, num_points, sizeof(geo_data_sweep_edge), geo_data_sweep_compare);
+    }
+    query.num_ring_edges = num_points;
+    
+    int status = geo_data_rtree_search(data, geo_data_query_box_filter, geo_data_ring_refine, &query, results, num_results);
+    free(query.rings[0]);
+    free(query.ring_edges[0]);
+    free(query.edges);
+    free(query.active);
+    if(status || query.failed) {
+        free(*results);
+        *results = NULL;
+        *num_results = 0;
+        return -1;
+    }
+    return 0;
+}
+
+// PROPERTIES
+
+static inline uint32_t geo_data_prop_u32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(uint32_t));
+    return v;
+}
+
+// copies the properties trailer of a file and builds its column table, *consumed is the trailer's length. returns -1
+// for a malformed trailer or when memory runs out. every dictionary code and string end is checked here so readers
+// can trust them
+static int geo_data_props_parse(geo_data *data, const uint8_t *trailer, uint64_t len, uint64_t *consumed) {
+    if(len < 8 || data->props) {
+        return -1;
+    }
+    unsigned int num_columns = geo_data_prop_u32(trailer + 4);
+    if(num_columns == 0) {
+        *consumed = 8;
+        return 0;
+    }
+    if(num_columns > (len - 8) / (GEO_DATA_PROP_NAME_LEN + 4)) {
+        return -1;
+    }
+    geo_data_prop_column *columns = (geo_data_prop_column *)calloc(num_columns, sizeof(geo_data_prop_column));
+    if(!columns) {
+        return -1;
+    }
+    
+    uint64_t n = data->num_polygons, offset = 8;
+    for(unsigned int c = 0; c < num_columns; ++c) {
+        geo_data_prop_column *column = &columns[c];
+        if(len - offset < GEO_DATA_PROP_NAME_LEN + 4) {
+            free(columns);
+            return -1;
+        }
+        memcpy(column->name, trailer + offset, GEO_DATA_PROP_NAME_LEN);
+        column->name[GEO_DATA_PROP_NAME_LEN - 1] = '\0';
+        column->type = geo_data_prop_u32(trailer + offset + GEO_DATA_PROP_NAME_LEN);
+        offset += GEO_DATA_PROP_NAME_LEN + 4;
+        
+        if(column->type == GEO_DATA_PROP_INT64) {
+            if((len - offset) / sizeof(int64_t) < n) {
+                free(columns);
+                return -1;
+            }
+            column->values = offset;
+            offset += sizeof(int64_t) * n;
+        } else if(column->type == GEO_DATA_PROP_STRING) {
+            if(len - offset < 4) {
+                free(columns);
+                return -1;
+            }
+            column->num_strings = geo_data_prop_u32(trailer + offset);
+            offset += 4;
+            if((len - offset) / 4 < n + column->num_strings + 1) {
+                free(columns);
+                return -1;
+            }
+            column->values = offset;
+            column->ends = offset + 4 * n;
+            offset = column->ends + 4 * ((uint64_t)column->num_strings + 1);
+            for(uint64_t i = 0; i < n; ++i) {
+                if(geo_data_prop_u32(trailer + column->values + 4 * i) >= column->num_strings) {
+                    free(columns);
+                    return -1;
+                }
+            }
+            uint32_t prev = 0;
+            for(uint64_t i = 0; i <= column->num_strings; ++i) {
+                uint32_t end = geo_data_prop_u32(trailer + column->ends + 4 * i);
+                if(end < prev || (i == 0 && end != 0)) {
+                    free(columns);
+                    return -1;
+                }
+                prev = end;
+            }
+            if(len - offset < prev) {
+                free(columns);
+                return -1;
+            }
+            offset += prev;
+        } else {
+            free(columns);
+            return -1;
+        }
+    }
+    
+    data->props = (uint8_t *)malloc(offset);
+    if(!data->props) {
+        free(columns);
+        return -1;
+    }
+    memcpy(data->props, trailer, offset);
+    data->props_len = offset;
+    data->prop_columns = columns;
+    data->num_prop_columns = num_columns;
+    *consumed = offset;
+    return 0;
+}
+
+// index of the named column or -1
+int geo_data_prop_find(geo_data *data, const char *name);
+int geo_data_prop_find(geo_data *data, const char *name) {
+    for(unsigned int c = 0; data && c < data->num_prop_columns; ++c) {
+        if(strcmp(data->prop_columns[c].name, name) == 0) {
+            return (int)c;
+        }
+    }
+    return -1;
+}
+
+// int64 property of a polygon, returns -1 for an unknown polygon or a column of another type
+int geo_data_prop_int64(geo_data *data, unsigned int column, unsigned int n, int64_t *value);
+int geo_data_prop_int64(geo_data *data, unsigned int column, unsigned int n, int64_t *value) {
+    if(!data || column >= data->num_prop_columns || n >= data->num_polygons || data->prop_columns[column].type != GEO_DATA_PROP_INT64) {
+        return -1;
+    }
+    memcpy(value, data->props + data->prop_columns[column].values + sizeof(int64_t) * n, sizeof(int64_t));
+    return 0;
+}
+
+// string property of a polygon, not nul terminated, points into the dataset and lives as long as it does. NULL for an
+// unknown polygon or a column of another type
+const char *geo_data_prop_string(geo_data *data, unsigned int column, unsigned int n, unsigned int *len);
+const char *geo_data_prop_string(geo_data *data, unsigned int column, unsigned int n, unsigned int *len) {
+    if(!data || column >= data->num_prop_columns || n >= data->num_polygons || data->prop_columns[column].type != GEO_DATA_PROP_STRING) {
+        return NULL;
+    }
+    const geo_data_prop_column *c = &data->prop_columns[column];
+    uint32_t code = geo_data_prop_u32(data->props + c->values + 4 * (uint64_t)n);
+    uint32_t begin = geo_data_prop_u32(data->props + c->ends + 4 * (uint64_t)code);
+    uint32_t end = geo_data_prop_u32(data->props + c->ends + 4 * ((uint64_t)code + 1));
+    *len = end - begin;
+    return (const char *)data->props + c->ends + 4 * ((uint64_t)c->num_strings + 1) + begin;
+}
+
+unsigned int geo_data_prop_count(const geo_data *data) {
+    return data ? data->num_prop_columns : 0;
+}
+
+const char *geo_data_prop_name(const geo_data *data, unsigned int column) {
+    return data && column < data->num_prop_columns ? data->prop_columns[column].name : NULL;
+}
+
+// HIERARCHY
+
+#define GEO_DATA_PARENT_NONE 0xFFFFFFFFu
+
+// reads the parent of every polygon and lists the children of each, returns -1 for a malformed trailer, a parent out
+// of range, a cycle or when memory runs out
+static int geo_data_hierarchy_parse(geo_data *data, const uint8_t *trailer, uint64_t len, uint64_t *consumed) {
+    unsigned int n = data->num_polygons;
+    if(data->parents || (len - 4) / sizeof(unsigned int) < n) {
+        return -1;
+    }
+    data->parents = (unsigned int *)malloc(sizeof(unsigned int) * n);
+    data->child_offsets = (unsigned int *)calloc((size_t)n + 2, sizeof(unsigned int));
+    data->children = (unsigned int *)malloc(sizeof(unsigned int) * n);
+    uint8_t *state = (uint8_t *)calloc(n, 1);
+    int failed = !data->parents || !data->child_offsets || !data->children || !state;
+    if(!failed) {
+        memcpy(data->parents, trailer + 4, sizeof(unsigned int) * n);
+        for(unsigned int i = 0; i < n; ++i) {
+            failed |= data->parents[i] != GEO_DATA_PARENT_NONE && data->parents[i] >= n;
+        }
+    }
+    
+    // walks up from every polygon, meeting a polygon of the current walk again means a cycle
+    for(unsigned int i = 0; i < n && !failed; ++i) {
+        unsigned int p = i;
+        while(p != GEO_DATA_PARENT_NONE && state[p] == 0) {
+            state[p] = 1;
+            p = data->parents[p];
+        }
+        if(p != GEO_DATA_PARENT_NONE && state[p] == 1) {
+            failed = 1;
+            break;
+        }
+        for(p = i; p != GEO_DATA_PARENT_NONE && state[p] == 1; p = data->parents[p]) {
+            state[p] = 2;
+        }
+    }
+    free(state);
+    if(failed) {
+        free(data->parents);
+        free(data->child_offsets);
+        free(data->children);
+        data->parents = data->child_offsets = data->children = NULL;
+        return -1;
+    }
+    
+    // counting sort by parent, the top level goes to slot n. ascending indices keep lookup's first match order
+    unsigned int *offsets = data->child_offsets;
+    for(unsigned int i = 0; i < n; ++i) {
+        offsets[(data->parents[i] == GEO_DATA_PARENT_NONE ? n : data->parents[i]) + 1]++;
+    }
+    for(unsigned int i = 0; i <= n; ++i) {
+        offsets[i + 1] += offsets[i];
+    }
+    for(unsigned int i = 0; i < n; ++i) {
+        unsigned int parent = data->parents[i] == GEO_DATA_PARENT_NONE ? n : data->parents[i];
+        data->children[offsets[parent]++] = i;
+    }
+    for(unsigned int i = n + 1; i > 0; --i) {
+        offsets[i] = offsets[i - 1];
+    }
+    offsets[0] = 0;
+    *consumed = 4 + sizeof(unsigned int) * (uint64_t)n;
+    return 0;
+}
+
+// descends the hierarchy from the top level, testing only the children of the last hit, and writes the containing
+// polygons outermost first into path. returns how many were written, at most max_path. without a hierarchy the path
+// is the lookup result alone
+unsigned int geo_data_lookup_path(geo_data *data, double lng, double lat, int *path, unsigned int max_path);
+unsigned int geo_data_lookup_path(geo_data *data, double lng, double lat, int *path, unsigned int max_path) {
+    data = geo_data_local(data);
+    if(!data || max_path == 0 || !geo_data_in_domain(data, lng, lat)) {
+        return 0;
+    }
+    if(!data->parents) {
+        int n = geo_data_lookup_local(data, lng, lat);
+        if(n < 0) {
+            return 0;
+        }
+        path[0] = n;
+        return 1;
+    }
+    
+    unsigned int depth = 0, parent = data->num_polygons;
+    while(depth < max_path) {
+        unsigned int i = data->child_offsets[parent], end = data->child_offsets[parent + 1];
+        while(i < end && !geo_data_hit_test_polygon(data, data->children[i], lng, lat)) {
+            ++i;
+        }
+        if(i == end) {
+            break;
+        }
+        parent = data->children[i];
+        path[depth++] = (int)parent;
+    }
+    return depth;
+}
+
+// BATCH
+
+#define GEO_DATA_BATCH_SORT_MIN 1024
+#define GEO_DATA_RADIX_BITS 11
+
+typedef struct {
+    geo_data *data;
+    const double *coords;
+    const unsigned int *order; // optional permutation, points are visited in this order
+    int *results;
+} geo_data_batch;
+
+static void geo_data_lookup_batch_task(void *ctx, unsigned int begin, unsigned int end) {
+    geo_data_batch *batch = (geo_data_batch *)ctx;
+    const geo_data *data = geo_data_local(batch->data);
+    for(unsigned int n = begin; n < end; ++n) {
+        size_t i = batch->order ? batch->order[n] : n;
+        double lng = batch->coords[i * 2];
+        double lat = batch->coords[i * 2 + 1];
+        batch->results[i] = geo_data_valid_point(lng, lat) ? geo_data_lookup_local(data, lng, lat) : -1;
+    }
+}
+
+// spreads the low 32 bits of v to the even bits of the result
+static inline uint64_t geo_data_morton_spread(uint64_t v) {
+    v &= 0xffffffffULL;
+    v = (v | (v << 16)) & 0x0000ffff0000ffffULL;
+    v = (v | (v << 8)) & 0x00ff00ff00ff00ffULL;
+    v = (v | (v << 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    v = (v | (v << 2)) & 0x3333333333333333ULL;
+    v = (v | (v << 1)) & 0x5555555555555555ULL;
+    return v;
+}
+
+static inline uint64_t geo_data_morton_key(double lng, double lat) {
+    // NaN and out of range values clamp to the edges, their results are decided by the lookup anyway
+    double x = (lng + 180.0) / 360.0;
+    double y = (lat + 90.0) / 180.0;
+    x = x > 0.0 ? (x < 1.0 ? x : 1.0) : 0.0;
+    y = y > 0.0 ? (y < 1.0 ? y : 1.0) : 0.0;
+    uint64_t qx = (uint64_t)(x * 4294967295.0);
+    uint64_t qy = (uint64_t)(y * 4294967295.0);
+    return geo_data_morton_spread(qx) | (geo_data_morton_spread(qy) << 1);
+}
+
+// sorts the point indices by morton key with an LSD radix sort, returns NULL when out of memory
+static unsigned int *geo_data_morton_order(const double *coords, unsigned int num_points) {
+    uint64_t *keys = (uint64_t *)malloc(sizeof(uint64_t) * num_points * 2);
+    unsigned int *order = (unsigned int *)malloc(sizeof(unsigned int) * num_points * 2);
+    unsigned int *counts = (unsigned int *)malloc(sizeof(unsigned int) << GEO_DATA_RADIX_BITS);
+    if(!keys || !order || !counts) {
+        free(keys);
+        free(order);
+        free(counts);
+        return NULL;
+    }
+    
+    uint64_t *keys_in = keys, *keys_out = keys + num_points;
+    unsigned int *order_in = order, *order_out = order + num_points;
+    uint64_t all_and = ~0ULL, all_or = 0;
+    for(unsigned int i = 0; i < num_points; ++i) {
+        keys_in[i] = geo_data_morton_key(coords[(size_t)i * 2], coords[(size_t)i * 2 + 1]);
+        order_in[i] = i;
+        all_and &= keys_in[i];
+        all_or |= keys_in[i];
+    }
+    
+    const unsigned int radix = 1 << GEO_DATA_RADIX_BITS;
+    for(unsigned int shift = 0; shift < 64; shift += GEO_DATA_RADIX_BITS) {
+        // skip digits every key shares
+        if((((all_and ^ all_or) >> shift) & (radix - 1)) == 0) {
+            continue;
+        }
+        memset(counts, 0, sizeof(unsigned int) * radix);
+        for(unsigned int i = 0; i < num_points; ++i) {
+            counts[(keys_in[i] >> shift) & (radix - 1)]++;
+        }
+        unsigned int sum = 0;
+        for(unsigned int d = 0; d < radix; ++d) {
+            unsigned int c = counts[d];
+            counts[d] = sum;
+            sum += c;
+        }
+        for(unsigned int i = 0; i < num_points; ++i) {
+            unsigned int dst = counts[(keys_in[i] >> shift) & (radix - 1)]++;
+            keys_out[dst] = keys_in[i];
+            order_out[dst] = order_in[i];
+        }
+        uint64_t *kt = keys_in; keys_in = keys_out; keys_out = kt;
+        unsigned int *ot = order_in; order_in = order_out; order_out = ot;
+    }
+    
+    if(order_in != order) {
+        memcpy(order, order_in, sizeof(unsigned int) * num_points);
+    }
+    free(keys);
+    free(counts);
+    return order;
+}
+
+// looks up num_points interleaved lng/lat pairs on the default pool, results[i] receives the polygon index or -1.
+// with GEO_DATA_BATCH_SPATIAL_ORDER the points are visited in morton order so neighbouring lookups share cache lines.
+void geo_data_lookup_batch(geo_data *data, const double *coords, unsigned int num_points, int *results, unsigned int flags);
+void geo_data_lookup_batch(geo_data *data, const double *coords, unsigned int num_points, int *results, unsigned int flags) {
+    if(!data) {
+        for(unsigned int i = 0; i < num_points; ++i) {
+            results[i] = -1;
+        }
+        return;
+    }
+    geo_data_batch batch;
+    batch.data = data;
+    batch.coords = coords;
+    batch.order = NULL;
+    batch.results = results;
+    
+    unsigned int *order = NULL;
+    if((flags & GEO_DATA_BATCH_SPATIAL_ORDER) && num_points >= GEO_DATA_BATCH_SORT_MIN) {
+        // falls back to input order when the permutation can't be allocated
+        order = geo_data_morton_order(coords, num_points);
+        batch.order = order;
+    }
+    
+    geo_data_pool_run(geo_data_pool_default(), geo_data_lookup_batch_task, &batch, num_points, GEO_DATA_BATCH_CHUNK);
+    
+    free(order);
+}
+
+static void geo_data_free_arrays(geo_data *data) {
+    free(data->polygons);
+    free(data->offsets);
+    free(data->boxes);
+    free(data->inner);
+    free(data->lod);
+    free(data->lod_masks);
+    free(data->kernels);
+    free(data->slabs);
+    free(data->slab_cells);
+    free(data->slab_edges);
+    free(data->grid.cells);
+    free(data->grid.edges);
+    free(data->quad.nodes);
+    free(data->quad.refs);
+    free(data->quad.segments);
+    free(data->rtree.nodes);
+    free(data->rtree.items);
+    free(data->prop_columns);
+    free(data->props);
+    free(data->parents);
+    free(data->child_offsets);
+    free(data->children);
+}
+
+void geo_data_destroy(geo_data *data);
+void geo_data_destroy(geo_data *data) {
+    if(data) {
+        for(unsigned int i = 1; i < data->num_replicas; ++i) {
+            geo_data_destroy(data->replicas[i]);
+        }
+        free(data->replicas);
+        if(data->image) {
+            if(data->storage == GEO_DATA_STORAGE_HEAP) {
+                free(data->image);
+            } else {
+                munmap(data->image, data->image_len);
+            }
+        } else {
+            geo_data_free_arrays(data);
+        }
+        free(data->key);
+        free(data);
+    }
+}
+
+static geo_data *geo_data_load(const char *filepath, int *status) {
+    if(filepath == NULL || strlen(filepath) == 0) {
+        if(status) *status = -999;
+        return NULL;
+    }
+    
+    FILE *handle = fopen(filepath, "r");
+    if(handle == NULL) {
+        if(status) *status = -1000;
+        return NULL;
+    }
+    
+    if(fseek(handle, 0, SEEK_END)) {
+        fclose(handle);
+        if(status) *status = -1001;
+        return NULL;
+    }
+    off_t len = ftello(handle);
+    if(len < 0 || fseek(handle, 0, SEEK_SET)) {
+        fclose(handle);
+        if(status) *status = -1002;
+        return NULL;
+    }
+    
+    if((uint64_t)len < sizeof(unsigned char) * 4 + sizeof(unsigned int)) {
+        fclose(handle);
+        if(status) *status = -1003;
+        return NULL;
+    }
+    
+    // verify header
+    unsigned char header[4];
+    if(!fread(header, 1, sizeof(unsigned char) * 4, handle)) {
+        fclose(handle);
+        if(status) *status = -1004;
+        return NULL;
+    }
+    if(header[0] != 'G' || header[1] != 'E' || header[2] != 'O' || header[3] != '!') {
+        fclose(handle);
+        if(status) *status = -1005;
+        return NULL;
+    }
+    
+    // get num polygons
+    unsigned int num_polygons = 0;
+    if(!fread(&num_polygons, 1, sizeof(unsigned int), handle)) {
+        fclose(handle);
+        if(status) *status = -1006;
+        return NULL;
+    }
+    
+    // create geodata
+    geo_data *data = (geo_data *)calloc(1, sizeof(geo_data));
+    data->num_polygons = num_polygons;
+    data->refs = 1;
+    
+    // no polygons
+    if(data->num_polygons == 0) {
+        fclose(handle);
+        return data;
+    }
+    
+    // allocate buffer, files past the address space are out of memory
+    uint64_t buffer_len = (uint64_t)len - (sizeof(unsigned char) * 4 + sizeof(unsigned int));
+    void *buffer = buffer_len <= SIZE_MAX ? malloc((size_t)buffer_len) : NULL;
+    if(!buffer) {
+        geo_data_destroy(data);
+        fclose(handle);
+        if(status) *status = -1007;
+        return NULL;
+    }
+    
+    // assign buffer
+    data->polygons = (uint8_t *)buffer;
+    data->polygons_len = buffer_len;
+    
+    // read remaining data
+    if(fread(data->polygons, 1, (size_t)buffer_len, handle) != buffer_len) {
+        geo_data_destroy(data);
+        fclose(handle);
+        if(status) *status = -1008;
+        return NULL;
+    }
+    fclose(handle);
+    
+    // verify the polygon headers and build the offset table, coordinates are checked by the index build
+    data->offsets = (uint64_t *)malloc(sizeof(uint64_t) * data->num_polygons);
+    if(!data->offsets) {
+        geo_data_destroy(data);
+        if(status) *status = -1007;
+        return NULL;
+    }
+    uint64_t offset = 0;
+    for(unsigned int i = 0; i < data->num_polygons; ++i) {
+        uint64_t polygon_len = sizeof(unsigned int);
+        
+        // get num_coordinates
+        if(offset + polygon_len > buffer_len) {
+            geo_data_destroy(data);
+            if(status) *status = -1009;
+            return NULL;
+        }
+        unsigned int num_coordinates = *(unsigned int *)(data->polygons + offset);
+        polygon_len += (uint64_t)num_coordinates * sizeof(double) * 2;
+        if(offset + polygon_len > buffer_len) {
+            geo_data_destroy(data);
+            if(status) *status = -1010;
+            return NULL;
+        }
+        data->offsets[i] = offset;
+        offset += polygon_len;
+    }
+    
+    // trailers move to their own arrays, anything else after the polygons is ignored as before
+    uint64_t trailer = offset;
+    while(buffer_len - trailer >= 4) {
+        uint64_t consumed = 0;
+        if(memcmp(data->polygons + trailer, "PROP", 4) == 0) {
+            if(geo_data_props_parse(data, data->polygons + trailer, buffer_len - trailer, &consumed)) {
+                geo_data_destroy(data);
+                if(status) *status = -1016;
+                return NULL;
+            }
+        } else if(memcmp(data->polygons + trailer, "PRNT", 4) == 0) {
+            if(geo_data_hierarchy_parse(data, data->polygons + trailer, buffer_len - trailer, &consumed)) {
+                geo_data_destroy(data);
+                if(status) *status = -1015;
+                return NULL;
+            }
+        } else {
+            break;
+        }
+        trailer += consumed;
+    }
+    data->polygons_len = offset;
+    uint8_t *shrunk = offset < buffer_len ? (uint8_t *)realloc(data->polygons, offset ? (size_t)offset : 1) : NULL;
+    if(shrunk) {
+        data->polygons = shrunk;
+    }
+    
+    // validate and index in parallel
+    if(geo_data_index_build(data)) {
+        geo_data_destroy(data);
+        if(status) *status = -1011;
+        return NULL;
+    }
+    geo_data_set_domain(data, NULL);
+    
+    return data;
+};
+
+// loads filepath and builds the optional indexes asked for in options, which may be NULL
+geo_data *geo_data_create_with_options(const char *filepath, const geo_data_options *options, int *status);
+geo_data *geo_data_create_with_options(const char *filepath, const geo_data_options *options, int *status) {
+    geo_data *data = geo_data_load(filepath, status);
+    if(data && options) {
+        data->robust = options->robust;
+        geo_data_set_domain(data, options->domain);
+    }
+    if(data && options && options->quadtree) {
+        // lookups keep scanning when the tree doesn't fit its memory cap
+        geo_data_quad_build(data, options);
+    }
+    return data;
+}
+
+geo_data* geo_data_create(const char *filepath, int *status);
+geo_data* geo_data_create(const char *filepath, int *status) {
+    return geo_data_create_with_options(filepath, NULL, status);
+}
+
+// IMAGE
+
+// position independent copy of a prepared dataset, every array lives in one block and is addressed by offset
+// from its start, so the block can be mapped at any address in any process
+//
+// IMAGE LAYOUT
+// geo_data_image header
+// <SECTIONS>, each aligned to GEO_DATA_IMAGE_ALIGN
+
+#define GEO_DATA_IMAGE_VERSION 14
+#define GEO_DATA_IMAGE_ALIGN 64
+#define GEO_DATA_IMAGE_SOURCE_LEN 1024
+
+enum {
+    GEO_DATA_SECTION_POLYGONS,
+    GEO_DATA_SECTION_OFFSETS,
+    GEO_DATA_SECTION_BOXES,
+    GEO_DATA_SECTION_INNER,
+    GEO_DATA_SECTION_LOD,
+    GEO_DATA_SECTION_LOD_MASKS,
+    GEO_DATA_SECTION_KERNELS,
+    GEO_DATA_SECTION_SLABS,
+    GEO_DATA_SECTION_SLAB_CELLS,
+    GEO_DATA_SECTION_SLAB_EDGES,
+    GEO_DATA_SECTION_CELLS,
+    GEO_DATA_SECTION_EDGES,
+    GEO_DATA_SECTION_QUAD_NODES,
+    GEO_DATA_SECTION_QUAD_REFS,
+    GEO_DATA_SECTION_QUAD_SEGMENTS,
+    GEO_DATA_SECTION_RTREE_NODES,
+    GEO_DATA_SECTION_RTREE_ITEMS,
+    GEO_DATA_SECTION_PROP_COLUMNS,
+    GEO_DATA_SECTION_PROPS,
+    GEO_DATA_SECTION_PARENTS,
+    GEO_DATA_SECTION_CHILD_OFFSETS,
+    GEO_DATA_SECTION_CHILDREN,
+    GEO_DATA_SECTION_COUNT
+};
+
+typedef struct {
+    uint64_t offset;
+    uint64_t length;
+} geo_data_section;
+
+typedef struct {
+    unsigned char magic[4]; // "GEOI"
+    unsigned int version;
+    unsigned int ready; // set last, once every section is written
+    unsigned int num_polygons;
+    unsigned int num_invalid;
+    uint64_t size;
+    char source[GEO_DATA_IMAGE_SOURCE_LEN]; // registry key of the file the image was built from
+    geo_data_box extent;
+    unsigned int cols;
+    unsigned int rows;
+    double cell_lng;
+    double cell_lat;
+    geo_data_box quad_extent;
+    unsigned int quad_nodes;
+    unsigned int quad_refs;
+    unsigned int quad_segments;
+    unsigned int robust;
+    geo_data_box domain;
+    geo_data_section sections[GEO_DATA_SECTION_COUNT];
+} geo_data_image;
+
+static void geo_data_image_sections(geo_data *data, void **ptrs) {
+    ptrs[GEO_DATA_SECTION_POLYGONS] = data->polygons;
+    ptrs[GEO_DATA_SECTION_OFFSETS] = data->offsets;
+    ptrs[GEO_DATA_SECTION_BOXES] = data->boxes;
+    ptrs[GEO_DATA_SECTION_INNER] = data->inner;
+    ptrs[GEO_DATA_SECTION_LOD] = data->lod;
+    ptrs[GEO_DATA_SECTION_LOD_MASKS] = data->lod_masks;
+    ptrs[GEO_DATA_SECTION_KERNELS] = data->kernels;
+    ptrs[GEO_DATA_SECTION_SLABS] = data->slabs;
+    ptrs[GEO_DATA_SECTION_SLAB_CELLS] = data->slab_cells;
+    ptrs[GEO_DATA_SECTION_SLAB_EDGES] = data->slab_edges;
+    ptrs[GEO_DATA_SECTION_CELLS] = data->grid.cells;
+    ptrs[GEO_DATA_SECTION_EDGES] = data->grid.edges;
+    ptrs[GEO_DATA_SECTION_QUAD_NODES] = data->quad.nodes;
+    ptrs[GEO_DATA_SECTION_QUAD_REFS] = data->quad.refs;
+    ptrs[GEO_DATA_SECTION_QUAD_SEGMENTS] = data->quad.segments;
+    ptrs[GEO_DATA_SECTION_RTREE_NODES] = data->rtree.nodes;
+    ptrs[GEO_DATA_SECTION_RTREE_ITEMS] = data->rtree.items;
+    ptrs[GEO_DATA_SECTION_PROP_COLUMNS] = data->prop_columns;
+    ptrs[GEO_DATA_SECTION_PROPS] = data->props;
+    ptrs[GEO_DATA_SECTION_PARENTS] = data->parents;
+    ptrs[GEO_DATA_SECTION_CHILD_OFFSETS] = data->child_offsets;
+    ptrs[GEO_DATA_SECTION_CHILDREN] = data->children;
+}
+
+// fills in the header for data and returns the size of the whole image
+static size_t geo_data_image_layout(geo_data *data, geo_data_image *header) {
+    memset(header, 0, sizeof(geo_data_image));
+    memcpy(header->magic, "GEOI", 4);
+    header->version = GEO_DATA_IMAGE_VERSION;
+    header->num_polygons = data->num_polygons;
+    header->num_invalid = data->num_invalid;
+    if(data->key) {
+        strncpy(header->source, data->key, GEO_DATA_IMAGE_SOURCE_LEN - 1);
+    }
+    header->extent = data->grid.extent;
+    header->cols = data->grid.cols;
+    header->rows = data->grid.rows;
+    header->cell_lng = data->grid.cell_lng;
+    header->cell_lat = data->grid.cell_lat;
+    header->quad_extent = data->quad.extent;
+    header->quad_nodes = data->quad.num_nodes;
+    header->quad_refs = data->quad.num_refs;
+    header->quad_segments = data->quad.num_segments;
+    header->robust = data->robust;
+    header->domain = data->domain;
+    
+    uint64_t lengths[GEO_DATA_SECTION_COUNT];
+    lengths[GEO_DATA_SECTION_POLYGONS] = data->polygons ? data->polygons_len : 0;
+    lengths[GEO_DATA_SECTION_OFFSETS] = data->offsets ? sizeof(uint64_t) * data->num_polygons : 0;
+    lengths[GEO_DATA_SECTION_BOXES] = data->boxes ? sizeof(geo_data_box) * data->num_polygons : 0;
+    lengths[GEO_DATA_SECTION_INNER] = data->inner ? sizeof(geo_data_box) * data->num_polygons : 0;
+    lengths[GEO_DATA_SECTION_LOD] = data->lod ? sizeof(unsigned int) * data->num_polygons : 0;
+    lengths[GEO_DATA_SECTION_LOD_MASKS] = data->lod ? (uint64_t)GEO_DATA_LOD_BYTES * data->num_lod_masks : 0;
+    lengths[GEO_DATA_SECTION_KERNELS] = data->kernels ? data->num_polygons : 0;
+    lengths[GEO_DATA_SECTION_SLABS] = sizeof(geo_data_slab_table) * (uint64_t)data->num_slabs;
+    lengths[GEO_DATA_SECTION_SLAB_CELLS] = lengths[GEO_DATA_SECTION_SLAB_EDGES] = 0;
+    if(data->num_slabs) {
+        const geo_data_slab_table *last = &data->slabs[data->num_slabs - 1];
+        lengths[GEO_DATA_SECTION_SLAB_CELLS] = sizeof(uint64_t) * (last->cells + last->num_slabs + 1);
+        lengths[GEO_DATA_SECTION_SLAB_EDGES] = sizeof(unsigned int) * data->slab_cells[last->cells + last->num_slabs];
+    }
+    lengths[GEO_DATA_SECTION_CELLS] = data->grid.cells ? sizeof(unsigned int) * ((uint64_t)data->grid.cols * data->grid.rows + 1) : 0;
+    lengths[GEO_DATA_SECTION_EDGES] = data->grid.cells ? sizeof(geo_data_edge) * data->grid.cells[data->grid.cols * data->grid.rows] : 0;
+    lengths[GEO_DATA_SECTION_QUAD_NODES] = sizeof(geo_data_quad_node) * (uint64_t)data->quad.num_nodes;
+    lengths[GEO_DATA_SECTION_QUAD_REFS] = sizeof(geo_data_quad_ref) * (uint64_t)data->quad.num_refs;
+    lengths[GEO_DATA_SECTION_QUAD_SEGMENTS] = sizeof(geo_data_segment) * (uint64_t)data->quad.num_segments;
+    lengths[GEO_DATA_SECTION_RTREE_NODES] = sizeof(geo_data_rtree_node) * (uint64_t)data->rtree.num_nodes;
+    lengths[GEO_DATA_SECTION_RTREE_ITEMS] = sizeof(unsigned int) * (uint64_t)data->rtree.num_items;
+    lengths[GEO_DATA_SECTION_PROP_COLUMNS] = sizeof(geo_data_prop_column) * (uint64_t)data->num_prop_columns;
+    lengths[GEO_DATA_SECTION_PROPS] = data->props ? data->props_len : 0;
+    lengths[GEO_DATA_SECTION_PARENTS] = data->parents ? sizeof(unsigned int) * (uint64_t)data->num_polygons : 0;
+    lengths[GEO_DATA_SECTION_CHILD_OFFSETS] = data->parents ? sizeof(unsigned int) * ((uint64_t)data->num_polygons + 2) : 0;
+    lengths[GEO_DATA_SECTION_CHILDREN] = data->parents ? sizeof(unsigned int) * (uint64_t)data->num_polygons : 0;
+    
+    uint64_t offset = sizeof(geo_data_image);
+    for(int i = 0; i < GEO_DATA_SECTION_COUNT; ++i) {
+        offset = (offset + GEO_DATA_IMAGE_ALIGN - 1) & ~(uint64_t)(GEO_DATA_IMAGE_ALIGN - 1);
+        header->sections[i].offset = offset;
+        header->sections[i].length = lengths[i];
+        offset += lengths[i];
+    }
+    header->size = offset;
+    return (size_t)offset;
+}
+
+// copies the sections of data into image, the header is left to the caller
+static void geo_data_image_write(geo_data *data, const geo_data_image *header, uint8_t *image) {
+    void *ptrs[GEO_DATA_SECTION_COUNT];
+    geo_data_image_sections(data, ptrs);
+    for(int i = 0; i < GEO_DATA_SECTION_COUNT; ++i) {
+        if(header->sections[i].length) {
+            memcpy(image + header->sections[i].offset, ptrs[i], header->sections[i].length);
+        }
+    }
+}
+
+// points data at the sections of a complete image, returns non zero when the image is unusable
+static int geo_data_image_bind(geo_data *data, uint8_t *image, size_t len) {
+    const geo_data_image *header = (const geo_data_image *)image;
+    if(len < sizeof(geo_data_image) || memcmp(header->magic, "GEOI", 4) != 0 ||
+       header->version != GEO_DATA_IMAGE_VERSION || !header->ready || header->size > len) {
+        return -1;
+    }
+    for(int i = 0; i < GEO_DATA_SECTION_COUNT; ++i) {
+        if(header->sections[i].offset + header->sections[i].length > header->size) {
+            return -1;
+        }
+    }
+    
+    #define GEO_DATA_SECTION_PTR(type, id) (header->sections[id].length ? (type)(image + header->sections[id].offset) : NULL)
+    data->num_polygons = header->num_polygons;
+    data->num_invalid = header->num_invalid;
+    data->polygons_len = header->sections[GEO_DATA_SECTION_POLYGONS].length;
+    data->polygons = GEO_DATA_SECTION_PTR(uint8_t *, GEO_DATA_SECTION_POLYGONS);
+    data->offsets = GEO_DATA_SECTION_PTR(uint64_t *, GEO_DATA_SECTION_OFFSETS);
+    data->boxes = GEO_DATA_SECTION_PTR(geo_data_box *, GEO_DATA_SECTION_BOXES);
+    data->inner = GEO_DATA_SECTION_PTR(geo_data_box *, GEO_DATA_SECTION_INNER);
+    data->lod = GEO_DATA_SECTION_PTR(unsigned int *, GEO_DATA_SECTION_LOD);
+    data->lod_masks = GEO_DATA_SECTION_PTR(uint8_t *, GEO_DATA_SECTION_LOD_MASKS);
+    data->num_lod_masks = (unsigned int)(header->sections[GEO_DATA_SECTION_LOD_MASKS].length / GEO_DATA_LOD_BYTES);
+    data->kernels = GEO_DATA_SECTION_PTR(uint8_t *, GEO_DATA_SECTION_KERNELS);
+    data->slabs = GEO_DATA_SECTION_PTR(geo_data_slab_table *, GEO_DATA_SECTION_SLABS);
+    data->num_slabs = (unsigned int)(header->sections[GEO_DATA_SECTION_SLABS].length / sizeof(geo_data_slab_table));
+    data->slab_cells = GEO_DATA_SECTION_PTR(uint64_t *, GEO_DATA_SECTION_SLAB_CELLS);
+    data->slab_edges = GEO_DATA_SECTION_PTR(unsigned int *, GEO_DATA_SECTION_SLAB_EDGES);
+    data->grid.extent = header->extent;
+    data->grid.cols = header->cols;
+    data->grid.rows = header->rows;
+    data->grid.cell_lng = header->cell_lng;
+    data->grid.cell_lat = header->cell_lat;
+    data->grid.cells = GEO_DATA_SECTION_PTR(unsigned int *, GEO_DATA_SECTION_CELLS);
+    data->grid.edges = GEO_DATA_SECTION_PTR(geo_data_edge *, GEO_DATA_SECTION_EDGES);
+    data->quad.extent = header->quad_extent;
+    data->quad.num_nodes = header->quad_nodes;
+    data->quad.num_refs = header->quad_refs;
+    data->quad.num_segments = header->quad_segments;
+    data->robust = header->robust;
+    data->domain = header->domain;
+    data->quad.nodes = GEO_DATA_SECTION_PTR(geo_data_quad_node *, GEO_DATA_SECTION_QUAD_NODES);
+    data->quad.refs = GEO_DATA_SECTION_PTR(geo_data_quad_ref *, GEO_DATA_SECTION_QUAD_REFS);
+    data->quad.segments = GEO_DATA_SECTION_PTR(geo_data_segment *, GEO_DATA_SECTION_QUAD_SEGMENTS);
+    data->rtree.nodes = GEO_DATA_SECTION_PTR(geo_data_rtree_node *, GEO_DATA_SECTION_RTREE_NODES);
+    data->rtree.num_nodes = (unsigned int)(header->sections[GEO_DATA_SECTION_RTREE_NODES].length / sizeof(geo_data_rtree_node));
+    data->rtree.items = GEO_DATA_SECTION_PTR(unsigned int *, GEO_DATA_SECTION_RTREE_ITEMS);
+    data->rtree.num_items = (unsigned int)(header->sections[GEO_DATA_SECTION_RTREE_ITEMS].length / sizeof(unsigned int));
+    data->prop_columns = GEO_DATA_SECTION_PTR(geo_data_prop_column *, GEO_DATA_SECTION_PROP_COLUMNS);
+    data->num_prop_columns = (unsigned int)(header->sections[GEO_DATA_SECTION_PROP_COLUMNS].length / sizeof(geo_data_prop_column));
+    data->props = GEO_DATA_SECTION_PTR(uint8_t *, GEO_DATA_SECTION_PROPS);
+    data->props_len = header->sections[GEO_DATA_SECTION_PROPS].length;
+    data->parents = GEO_DATA_SECTION_PTR(unsigned int *, GEO_DATA_SECTION_PARENTS);
+    data->child_offsets = GEO_DATA_SECTION_PTR(unsigned int *, GEO_DATA_SECTION_CHILD_OFFSETS);
+    data->children = GEO_DATA_SECTION_PTR(unsigned int *, GEO_DATA_SECTION_CHILDREN);
+    #undef GEO_DATA_SECTION_PTR
+    return 0;
+}
+
+// HUGE PAGES
+
+#define GEO_DATA_HUGE_PAGE (2 * 1024 * 1024)
+
+// maps len bytes backed by huge pages, trying MAP_HUGETLB first and transparent huge pages second
+static uint8_t *geo_data_huge_alloc(size_t *len, int *storage) {
+    size_t huge_len = (*len + GEO_DATA_HUGE_PAGE - 1) & ~(size_t)(GEO_DATA_HUGE_PAGE - 1);
+#ifdef MAP_HUGETLB
+    void *ptr = mmap(NULL, huge_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if(ptr != MAP_FAILED) {
+        *len = huge_len;
+        *storage = GEO_DATA_STORAGE_HUGETLB;
+        return (uint8_t *)ptr;
+    }
+#endif
+    // over allocate so the block can start on a huge page boundary, then trim both ends
+    size_t map_len = huge_len + GEO_DATA_HUGE_PAGE;
+    uint8_t *base = (uint8_t *)mmap(NULL, map_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(base == MAP_FAILED) {
+        return NULL;
+    }
+    uint8_t *aligned = (uint8_t *)(((uintptr_t)base + GEO_DATA_HUGE_PAGE - 1) & ~(uintptr_t)(GEO_DATA_HUGE_PAGE - 1));
+    if(aligned > base) {
+        munmap(base, aligned - base);
+    }
+    if(base + map_len > aligned + huge_len) {
+        munmap(aligned + huge_len, base + map_len - (aligned + huge_len));
+    }
+#ifdef MADV_HUGEPAGE
+    madvise(aligned, huge_len, MADV_HUGEPAGE);
+#endif
+    *len = huge_len;
+    *storage = GEO_DATA_STORAGE_THP;
+    return aligned;
+}
+
+#define MPOL_PREFERRED_ 1 // from linux/mempolicy.h
+
+// asks the kernel to place the pages of an untouched mapping on node
+static void geo_data_numa_bind(void *ptr, size_t len, unsigned int node) {
+#ifdef SYS_mbind
+    unsigned long mask[GEO_DATA_NUMA_MAX_NODES / (8 * sizeof(unsigned long))] = {0};
+    mask[node / (8 * sizeof(unsigned long))] = 1UL << (node % (8 * sizeof(unsigned long)));
+    syscall(SYS_mbind, ptr, len, MPOL_PREFERRED_, mask, GEO_DATA_NUMA_MAX_NODES + 1, 0);
+#endif
+}
+
+static uint8_t *geo_data_image_alloc(size_t *len, int huge_pages, int *storage) {
+    if(huge_pages) {
+        return geo_data_huge_alloc(len, storage);
+    }
+    void *ptr = mmap(NULL, *len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(ptr == MAP_FAILED) {
+        return NULL;
+    }
+    *storage = GEO_DATA_STORAGE_ANONYMOUS;
+    return (uint8_t *)ptr;
+}
+
+// moves every array of data into a single mapped image, placed on node unless node is negative
+static int geo_data_pack(geo_data *data, int huge_pages, int node) {
+    if(data->image) {
+        return 0;
+    }
+    geo_data_image header;
+    size_t len = geo_data_image_layout(data, &header);
+    int storage = GEO_DATA_STORAGE_HEAP;
+    uint8_t *image = geo_data_image_alloc(&len, huge_pages, &storage);
+    if(!image) {
+        return -1;
+    }
+    if(node >= 0) {
+        geo_data_numa_bind(image, len, (unsigned int)node);
+    }
+    geo_data_image_write(data, &header, image);
+    header.ready = 1;
+    memcpy(image, &header, sizeof(geo_data_image));
+    
+    geo_data_free_arrays(data);
+    geo_data_image_bind(data, image, len);
+    data->image = image;
+    data->image_len = len;
+    data->storage = storage;
+    return 0;
+}
+
+// gives every NUMA node its own copy of a private dataset. lookups then read the copy local to the calling
+// thread. on a single node machine nothing happens.
+static int geo_data_replicate(geo_data *data, int huge_pages) {
+    unsigned int num_nodes = geo_data_numa_num_nodes();
+    if(num_nodes < 2 || data->num_replicas || data->storage == GEO_DATA_STORAGE_SHARED) {
+        return 0;
+    }
+    if(!data->image && geo_data_pack(data, huge_pages, 0)) {
+        return -1;
+    }
+    geo_data **replicas = (geo_data **)calloc(num_nodes, sizeof(geo_data *));
+    if(!replicas) {
+        return -1;
+    }
+    replicas[0] = data;
+    for(unsigned int node = 1; node < num_nodes; ++node) {
+        geo_data *replica = (geo_data *)calloc(1, sizeof(geo_data));
+        size_t len = data->image_len;
+        int storage = GEO_DATA_STORAGE_HEAP;
+        uint8_t *image = replica ? geo_data_image_alloc(&len, huge_pages, &storage) : NULL;
+        if(!image) {
+            free(replica);
+            for(unsigned int i = 1; i < node; ++i) {
+                geo_data_destroy(replicas[i]);
+            }
+            free(replicas);
+            return -1;
+        }
+        geo_data_numa_bind(image, len, node);
+        memcpy(image, data->image, data->image_len);
+        geo_data_image_bind(replica, image, len);
+        replica->image = image;
+        replica->image_len = len;
+        replica->storage = storage;
+        replica->refs = 1;
+        replicas[node] = replica;
+    }
+    data->replicas = replicas;
+    data->num_replicas = num_nodes;
+    return 0;
+}
+
+// sums the huge page backed kilobytes of every mapping overlapping [start, start + len) as reported by the kernel
+static size_t geo_data_huge_bytes(const uint8_t *start, size_t len) {
+    FILE *smaps = fopen("/proc/self/smaps", "r");
+    if(!smaps) {
+        return 0;
+    }
+    size_t total = 0;
+    int inside = 0;
+    char line[512];
+    while(fgets(line, sizeof(line), smaps)) {
+        unsigned long long lo, hi, kb;
+        char field[64];
+        if(sscanf(line, "%llx-%llx ", &lo, &hi) == 2 && strchr(line, '-') < strchr(line, ' ')) {
+            inside = lo < (uintptr_t)(start + len) && hi > (uintptr_t)start;
+        } else if(inside && sscanf(line, "%63[^:]: %llu kB", field, &kb) == 2 &&
+                  (!strcmp(field, "AnonHugePages") || !strcmp(field, "ShmemPmdMapped") ||
+                   !strcmp(field, "Private_Hugetlb") || !strcmp(field, "Shared_Hugetlb"))) {
+            total += (size_t)kb * 1024;
+        }
+    }
+    fclose(smaps);
+    return total;
+}
+
+// SHARED MEMORY
+
+#define GEO_DATA_SHARED_ATTEMPTS 3
+#define GEO_DATA_SHARED_WAITS 200
+#define GEO_DATA_SHARED_WAIT_US 10000
+
+static int geo_data_shared_name(const char *name, char *buffer, size_t len) {
+    int n = snprintf(buffer, len, "%s%s", name[0] == '/' ? "" : "/", name);
+    return n <= 0 || (size_t)n >= len ? -1 : 0;
+}
+
+// maps an existing segment read only, returns NULL with status set on failure
+static geo_data *geo_data_shared_attach(const char *name, const char *key, int *status) {
+    int fd = shm_open(name, O_RDONLY, 0);
+    if(fd < 0) {
+        if(status) *status = -1012;
+        return NULL;
+    }
+    // the creator holds an exclusive lock until the image is complete
+    struct stat st;
+    if(flock(fd, LOCK_SH) || fstat(fd, &st)) {
+        close(fd);
+        if(status) *status = -1012;
+        return NULL;
+    }
+    if(st.st_size == 0) {
+        close(fd);
+        if(status) *status = -1014;
+        return NULL;
+    }
+    if((size_t)st.st_size < sizeof(geo_data_image)) {
+        close(fd);
+        if(status) *status = -1013;
+        return NULL;
+    }
+    
+    void *image = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(image == MAP_FAILED) {
+        if(status) *status = -1012;
+        return NULL;
+    }
+    
+    geo_data *data = (geo_data *)calloc(1, sizeof(geo_data));
+    if(!data || geo_data_image_bind(data, (uint8_t *)image, (size_t)st.st_size) ||
+       (key && strncmp(((geo_data_image *)image)->source, key, GEO_DATA_IMAGE_SOURCE_LEN - 1) != 0)) {
+        free(data);
+        munmap(image, (size_t)st.st_size);
+        if(status) *status = -1013;
+        return NULL;
+    }
+#ifdef MADV_HUGEPAGE
+    madvise(image, (size_t)st.st_size, MADV_HUGEPAGE);
+#endif
+    data->image = (uint8_t *)image;
+    data->image_len = (size_t)st.st_size;
+    data->storage = GEO_DATA_STORAGE_SHARED;
+    data->refs = 1;
+    return data;
+}
+
+// copies a loaded dataset into a new segment and rebinds it to the read only mapping
+static int geo_data_shared_publish(geo_data *data, int fd) {
+    geo_data_image header;
+    size_t len = geo_data_image_layout(data, &header);
+    if(ftruncate(fd, (off_t)len)) {
+        return -1;
+    }
+    uint8_t *image = (uint8_t *)mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(image == MAP_FAILED) {
+        return -1;
+    }
+    geo_data_image_write(data, &header, image);
+    memcpy(image, &header, sizeof(geo_data_image));
+    __atomic_store_n(&((geo_data_image *)image)->ready, 1, __ATOMIC_RELEASE);
+    mprotect(image, len, PROT_READ);
+#ifdef MADV_HUGEPAGE
+    madvise(image, len, MADV_HUGEPAGE);
+#endif
+    
+    geo_data_free_arrays(data);
+    geo_data_image_bind(data, image, len);
+    data->image = image;
+    data->image_len = len;
+    data->storage = GEO_DATA_STORAGE_SHARED;
+    return 0;
+}
+
+static geo_data *geo_data_shared_create(const char *filepath, const geo_data_options *options, const char *key, const char *name,
+                                        int fd, int *status) {
+    flock(fd, LOCK_EX);
+    geo_data *data = geo_data_create_with_options(filepath, options, status);
+    if(data) {
+        data->key = strdup(key);
+        if(!data->key || geo_data_shared_publish(data, fd)) {
+            geo_data_destroy(data);
+            data = NULL;
+            if(status) *status = -1012;
+        }
+    }
+    if(!data) {
+        shm_unlink(name);
+    }
+    flock(fd, LOCK_UN);
+    close(fd);
+    return data;
+}
+
+// attaches to the named segment, or loads filepath and publishes it there when the segment is missing or was
+// built from a different file. without a filepath the segment has to exist already.
+static geo_data *geo_data_shared_open(const char *filepath, const geo_data_options *options, const char *key, int *status) {
+    const char *shared_name = options->shared_name;
+    char name[256];
+    if(geo_data_shared_name(shared_name, name, sizeof(name))) {
+        if(status) *status = -1013;
+        return NULL;
+    }
+    
+    unsigned int waits = 0;
+    for(unsigned int attempt = 0; attempt < GEO_DATA_SHARED_ATTEMPTS; ) {
+        if(filepath) {
+            int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+            if(fd >= 0) {
+                return geo_data_shared_create(filepath, options, key, name, fd, status);
+            }
+            if(errno != EEXIST) {
+                if(status) *status = -1012;
+                return NULL;
+            }
+        }
+        
+        int attach_status = 0;
+        geo_data *data = geo_data_shared_attach(name, filepath ? key : NULL, &attach_status);
+        if(attach_status == -1014) {
+            // created but not locked by its creator yet
+            if(++waits < GEO_DATA_SHARED_WAITS) {
+                usleep(GEO_DATA_SHARED_WAIT_US);
+                continue;
+            }
+            attach_status = -1013;
+        }
+        if(data || attach_status != -1013 || !filepath) {
+            if(status) *status = attach_status;
+            return data;
+        }
+        
+        // stale, half written by a crashed creator or built from another file. processes mapping it keep their copy
+        shm_unlink(name);
+        waits = 0;
+        ++attempt;
+    }
+    if(status) *status = -1013;
+    return NULL;
+}
+
+// SHARING
+
+// datasets opened through geo_data_open are immutable, refcounted and registered process wide so every
+// thread opening the same file, or holding its id, shares a single copy
+
+// an open in progress. the mutex isn't held while loading, later openers of the same key wait for the first one
+// on the registry's condition instead
+typedef struct geo_data_opening {
+    const char *key;
+    int done;
+    geo_data *data; // NULL when the load failed, every waiter then tries again
+    unsigned int waiters;
+    struct geo_data_opening *next;
+} geo_data_opening;
+
+static pthread_mutex_t geo_data_registry_mutex_ = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t geo_data_registry_cond_ = PTHREAD_COND_INITIALIZER;
+static geo_data *geo_data_registry_ = NULL;
+static geo_data_opening *geo_data_registry_opening_ = NULL;
+static unsigned int geo_data_registry_id_ = 0;
+
+// identifies a file by its canonical path and its identity on disk, so a rewritten file is loaded again, together
+// with every option that changes answers or layout, so opening a file with other options never returns a copy
+// prepared differently. the options go first, images keep only the start of long keys
+static char *geo_data_registry_key(const char *filepath, const geo_data_options *options) {
+    char path[PATH_MAX];
+    struct stat st;
+    if(!realpath(filepath, path) || stat(path, &st)) {
+        return NULL;
+    }
+    geo_data_options defaults;
+    if(!options) {
+        geo_data_options_init(&defaults);
+        options = &defaults;
+    }
+    const char *shared_name = options->shared_name ? options->shared_name : "";
+    size_t len = strlen(path) + strlen(shared_name) + 384;
+    char *key = (char *)malloc(len);
+    if(!key) {
+        return NULL;
+    }
+    int used = snprintf(key, len, "r%d:h%d:n%d:", options->robust ? 1 : 0, options->huge_pages ? 1 : 0, options->numa ? 1 : 0);
+    if(options->quadtree) {
+        used += snprintf(key + used, len - used, "q%u,%u,%zu:", options->quad_depth ? options->quad_depth : GEO_DATA_QUAD_DEPTH,
+                         options->quad_edges ? options->quad_edges : GEO_DATA_QUAD_EDGES,
+                         options->quad_memory ? options->quad_memory : (size_t)GEO_DATA_QUAD_MEMORY);
+    }
+    if(options->domain) {
+        // hex floats, two domains share a copy only when they're the same to the bit
+        used += snprintf(key + used, len - used, "d%a,%a,%a,%a:", options->domain->min_lng, options->domain->min_lat,
+                         options->domain->max_lng, options->domain->max_lat);
+    }
+    snprintf(key + used, len - used, "s%s:%llu:%llu:%lld:%lld:%s", shared_name, (unsigned long long)st.st_dev,
+             (unsigned long long)st.st_ino, (long long)st.st_size, (long long)st.st_mtime, path);
+    return key;
+}
+
+geo_data *geo_data_retain(geo_data *data);
+geo_data *geo_data_retain(geo_data *data) {
+    if(data) {
+        pthread_mutex_lock(&geo_data_registry_mutex_);
+        data->refs++;
+        pthread_mutex_unlock(&geo_data_registry_mutex_);
+    }
+    return data;
+}
+
+void geo_data_release(geo_data *data);
+void geo_data_release(geo_data *data) {
+    if(!data) {
+        return;
+    }
+    pthread_mutex_lock(&geo_data_registry_mutex_);
+    if(--data->refs > 0) {
+        pthread_mutex_unlock(&geo_data_registry_mutex_);
+        return;
+    }
+    for(geo_data **link = &geo_data_registry_; *link; link = &(*link)->next) {
+        if(*link == data) {
+            *link = data->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&geo_data_registry_mutex_);
+    geo_data_destroy(data);
+}
+
+// returns a retained reference to a registered dataset or NULL once every reference to it is gone
+geo_data *geo_data_from_id(unsigned int id);
+geo_data *geo_data_from_id(unsigned int id) {
+    geo_data *data = NULL;
+    pthread_mutex_lock(&geo_data_registry_mutex_);
+    for(geo_data *entry = geo_data_registry_; entry; entry = entry->next) {
+        if(entry->id == id) {
+            data = entry;
+            data->refs++;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&geo_data_registry_mutex_);
+    return data;
+}
+
+// process wide handle, see geo_data_from_id
+unsigned int geo_data_id(const geo_data *data) {
+    return data ? data->id : 0;
+}
+
+// like geo_data_create, but returns the already loaded copy when the file is open elsewhere in the process with the
+// same options.
+// filepath may be NULL when options name an existing shared segment. release the result with geo_data_release.
+geo_data *geo_data_open(const char *filepath, const geo_data_options *options, int *status);
+geo_data *geo_data_open(const char *filepath, const geo_data_options *options, int *status) {
+    const char *shared_name = options && options->shared_name && strlen(options->shared_name) ? options->shared_name : NULL;
+    if((filepath == NULL || strlen(filepath) == 0) && !shared_name) {
+        if(status) *status = -999;
+        return NULL;
+    }
+    char *key = NULL;
+    if(filepath) {
+        key = geo_data_registry_key(filepath, options);
+    } else if((key = (char *)malloc(strlen(shared_name) + 5))) {
+        sprintf(key, "shm:%s", shared_name);
+    }
+    if(!key) {
+        if(status) *status = -1000;
+        return NULL;
+    }
+    
+    pthread_mutex_lock(&geo_data_registry_mutex_);
+    geo_data_opening *pending = NULL;
+    while(!pending) {
+        geo_data *found = NULL;
+        for(geo_data *entry = geo_data_registry_; entry && !found; entry = entry->next) {
+            if(strcmp(entry->key, key) == 0) {
+                found = entry;
+            }
+        }
+        if(found) {
+            found->refs++;
+            pthread_mutex_unlock(&geo_data_registry_mutex_);
+            free(key);
+            return found;
+        }
+        
+        geo_data_opening *loading = geo_data_registry_opening_;
+        while(loading && strcmp(loading->key, key) != 0) {
+            loading = loading->next;
+        }
+        if(!loading) {
+            if(!(pending = (geo_data_opening *)calloc(1, sizeof(geo_data_opening)))) {
+                pthread_mutex_unlock(&geo_data_registry_mutex_);
+                free(key);
+                if(status) *status = -1000;
+                return NULL;
+            }
+            pending->key = key;
+            pending->next = geo_data_registry_opening_;
+            geo_data_registry_opening_ = pending;
+            break;
+        }
+        
+        // the loader reserves a reference for every waiter when it publishes
+        loading->waiters++;
+        while(!loading->done) {
+            pthread_cond_wait(&geo_data_registry_cond_, &geo_data_registry_mutex_);
+        }
+        found = loading->data;
+        if(--loading->waiters == 0) {
+            free(loading);
+        }
+        if(found) {
+            pthread_mutex_unlock(&geo_data_registry_mutex_);
+            free(key);
+            return found;
+        }
+    }
+    pthread_mutex_unlock(&geo_data_registry_mutex_);
+    
+    // loading, attaching or waiting for another process to publish its segment can take a while, every other
+    // open, release and lookup by id goes on meanwhile
+    geo_data *data = shared_name ? geo_data_shared_open(filepath, options, key, status) : geo_data_create_with_options(filepath, options, status);
+    if(data && !shared_name && options && options->numa) {
+        // falls back to a single copy when the replicas can't be allocated
+        geo_data_replicate(data, options->huge_pages);
+    }
+    if(data && !shared_name && options && options->huge_pages) {
+        // stays on the heap when no huge page backed memory is available
+        geo_data_pack(data, 1, -1);
+    }
+    
+    pthread_mutex_lock(&geo_data_registry_mutex_);
+    for(geo_data_opening **link = &geo_data_registry_opening_; *link; link = &(*link)->next) {
+        if(*link == pending) {
+            *link = pending->next;
+            break;
+        }
+    }
+    if(data) {
+        free(data->key);
+        data->key = key;
+        data->refs += pending->waiters;
+        data->id = ++geo_data_registry_id_;
+        data->next = geo_data_registry_;
+        geo_data_registry_ = data;
+    } else {
+        free(key);
+    }
+    pending->key = NULL;
+    pending->data = data;
+    pending->done = 1;
+    if(pending->waiters) {
+        pthread_cond_broadcast(&geo_data_registry_cond_);
+    } else {
+        free(pending);
+    }
+    pthread_mutex_unlock(&geo_data_registry_mutex_);
+    return data;
+}
+
+// LAYERS
+
+// several datasets queried together, i.e. countries, states and time zones. every layer is an ordinary registered
+// dataset, so layers share the process wide pool and are shared with plain opens of the same file and options
+typedef struct geo_data_layers {
+    unsigned int num_layers;
+    char **names;
+    geo_data **layers;
+} geo_data_layers;
+
+void geo_data_layers_destroy(geo_data_layers *layers);
+void geo_data_layers_destroy(geo_data_layers *layers) {
+    if(!layers) {
+        return;
+    }
+    for(unsigned int i = 0; i < layers->num_layers; ++i) {
+        free(layers->names[i]);
+        geo_data_release(layers->layers[i]);
+    }
+    free(layers->names);
+    free(layers->layers);
+    free(layers);
+}
+
+// opens every layer with the same options. on failure *failed, when given, is the index of the layer that couldn't
+// be opened and *status its geo_data_open status
+geo_data_layers *geo_data_layers_open(const char **names, const char **filepaths, unsigned int num_layers, const geo_data_options *options,
+                                      int *status, unsigned int *failed);
+geo_data_layers *geo_data_layers_open(const char **names, const char **filepaths, unsigned int num_layers, const geo_data_options *options,
+                                      int *status, unsigned int *failed) {
+    geo_data_layers *layers = (geo_data_layers *)calloc(1, sizeof(geo_data_layers));
+    if(layers) {
+        layers->names = (char **)calloc(num_layers ? num_layers : 1, sizeof(char *));
+        layers->layers = (geo_data **)calloc(num_layers ? num_layers : 1, sizeof(geo_data *));
+    }
+    if(!layers || !layers->names || !layers->layers) {
+        geo_data_layers_destroy(layers);
+        if(status) *status = -1000;
+        if(failed) *failed = 0;
+        return NULL;
+    }
+    for(unsigned int i = 0; i < num_layers; ++i) {
+        int layer_status = 0;
+        layers->names[i] = strdup(names[i]);
+        layers->layers[i] = layers->names[i] ? geo_data_open(filepaths[i], options, &layer_status) : NULL;
+        if(!layers->layers[i]) {
+            layers->num_layers = i + 1;
+            geo_data_layers_destroy(layers);
+            if(status) *status = layer_status ? layer_status : -1000;
+            if(failed) *failed = i;
+            return NULL;
+        }
+    }
+    layers->num_layers = num_layers;
+    return layers;
+}
+
+unsigned int geo_data_layers_count(const geo_data_layers *layers) {
+    return layers ? layers->num_layers : 0;
+}
+
+const char *geo_data_layers_name(const geo_data_layers *layers, unsigned int n) {
+    return layers && n < layers->num_layers ? layers->names[n] : NULL;
+}
+
+// the layer's dataset, borrowed from the layers, retain it to keep it past geo_data_layers_destroy
+geo_data *geo_data_layers_get(const geo_data_layers *layers, unsigned int n) {
+    return layers && n < layers->num_layers ? layers->layers[n] : NULL;
+}
+
+// containing polygon per layer, -1 where none. the point is validated and the NUMA node picked once for all layers
+void geo_data_lookup_all(geo_data_layers *layers, double lng, double lat, int *results);
+void geo_data_lookup_all(geo_data_layers *layers, double lng, double lat, int *results) {
+    int valid = geo_data_valid_point(lng, lat);
+    int node = -1;
+    for(unsigned int i = 0; i < layers->num_layers; ++i) {
+        const geo_data *data = layers->layers[i];
+        if(data->num_replicas) {
+            node = node < 0 ? (int)geo_data_numa_node() : node;
+            data = data->replicas[(unsigned int)node < data->num_replicas ? node : 0];
+        }
+        results[i] = valid ? geo_data_lookup_local(data, lng, lat) : -1;
+    }
+}
+
+// STATS
+
+void geo_data_get_stats(geo_data *data, geo_data_stats *stats);
+void geo_data_get_stats(geo_data *data, geo_data_stats *stats) {
+    memset(stats, 0, sizeof(geo_data_stats));
+    if(!data) {
+        return;
+    }
+    stats->num_polygons = data->num_polygons;
+    stats->num_invalid = data->num_invalid;
+    stats->storage = data->storage;
+    stats->num_replicas = data->num_replicas;
+    stats->quad_nodes = data->quad.num_nodes;
+    stats->quad_memory = sizeof(geo_data_quad_node) * (size_t)data->quad.num_nodes + sizeof(geo_data_quad_ref) * (size_t)data->quad.num_refs +
+                         sizeof(geo_data_segment) * (size_t)data->quad.num_segments;
+    if(data->image) {
+        stats->memory = data->image_len;
+        stats->huge_bytes = geo_data_huge_bytes(data->image, data->image_len);
+    } else {
+        geo_data_image header;
+        stats->memory = geo_data_image_layout(data, &header) - sizeof(geo_data_image);
+    }
+}
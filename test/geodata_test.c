@@ -0,0 +1,1125 @@
+// checks the accelerated paths of the C core against each other and against brute force references
+//
+// built against the geodata_core library and run by "make test". every dataset is generated into a temporary
+// directory, so the test needs nothing but the library. exits non zero when any check fails.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "geodata.h"
+
+#define GEO_DATA_TEST_RANDOM 20000
+#define GEO_DATA_TEST_PARENT_NONE 0xFFFFFFFFu
+#define GEO_DATA_TEST_METERS_PER_DEGREE (6371008.8 * M_PI / 180.0)
+
+static unsigned int geo_data_test_failures_ = 0;
+static unsigned int geo_data_test_checks_ = 0;
+
+#define CHECK(cond, ...)                                                                                               \
+    do {                                                                                                               \
+        geo_data_test_checks_++;                                                                                       \
+        if(!(cond)) {                                                                                                  \
+            if(geo_data_test_failures_++ < 50) {                                                                       \
+                fprintf(stderr, "%s:%d: ", __FILE__, __LINE__);                                                        \
+                fprintf(stderr, __VA_ARGS__);                                                                          \
+                fprintf(stderr, "\n");                                                                                 \
+            }                                                                                                          \
+        }                                                                                                              \
+    } while(0)
+
+// HELPERS
+
+static uint64_t geo_data_test_seed_ = 0x9E3779B97F4A7C15ULL;
+
+static double geo_data_test_random(void) {
+    geo_data_test_seed_ ^= geo_data_test_seed_ << 13;
+    geo_data_test_seed_ ^= geo_data_test_seed_ >> 7;
+    geo_data_test_seed_ ^= geo_data_test_seed_ << 17;
+    return (double)(geo_data_test_seed_ >> 11) / 9007199254740992.0;
+}
+
+static double geo_data_test_uniform(double min, double max) {
+    return min + (max - min) * geo_data_test_random();
+}
+
+typedef struct {
+    unsigned int num_coordinates;
+    double *coords; // interleaved lng/lat
+} geo_data_test_polygon;
+
+typedef struct {
+    unsigned int num_polygons;
+    geo_data_test_polygon *polygons;
+    unsigned int num_points;
+    double *points; // border points, interleaved lng/lat
+} geo_data_test_set;
+
+static void geo_data_test_add(geo_data_test_set *set, const double *coords, unsigned int num_coordinates) {
+    set->polygons = (geo_data_test_polygon *)realloc(set->polygons, sizeof(geo_data_test_polygon) * (set->num_polygons + 1));
+    geo_data_test_polygon *polygon = &set->polygons[set->num_polygons++];
+    polygon->num_coordinates = num_coordinates;
+    polygon->coords = (double *)malloc(sizeof(double) * 2 * (num_coordinates ? num_coordinates : 1));
+    memcpy(polygon->coords, coords, sizeof(double) * 2 * num_coordinates);
+}
+
+static void geo_data_test_add_point(geo_data_test_set *set, double lng, double lat) {
+    set->points = (double *)realloc(set->points, sizeof(double) * 2 * (set->num_points + 1));
+    set->points[set->num_points * 2] = lng;
+    set->points[set->num_points * 2 + 1] = lat;
+    set->num_points++;
+}
+
+static void geo_data_test_free(geo_data_test_set *set) {
+    for(unsigned int n = 0; n < set->num_polygons; ++n) {
+        free(set->polygons[n].coords);
+    }
+    free(set->polygons);
+    free(set->points);
+    memset(set, 0, sizeof(geo_data_test_set));
+}
+
+// growable byte buffer for files and trailers
+typedef struct {
+    unsigned char *bytes;
+    size_t len;
+} geo_data_test_buffer;
+
+static void geo_data_test_put(geo_data_test_buffer *buffer, const void *bytes, size_t len) {
+    buffer->bytes = (unsigned char *)realloc(buffer->bytes, buffer->len + len);
+    memcpy(buffer->bytes + buffer->len, bytes, len);
+    buffer->len += len;
+}
+
+static void geo_data_test_put_u32(geo_data_test_buffer *buffer, unsigned int v) {
+    geo_data_test_put(buffer, &v, sizeof(v));
+}
+
+static char geo_data_test_dir_[256];
+
+static const char *geo_data_test_path(const char *name) {
+    static char path[512];
+    snprintf(path, sizeof(path), "%s/%s", geo_data_test_dir_, name);
+    return path;
+}
+
+// the set's polygons followed by the given trailer bytes, returns the file's path
+static const char *geo_data_test_write(const char *name, const geo_data_test_set *set, const geo_data_test_buffer *trailer) {
+    geo_data_test_buffer file = {NULL, 0};
+    geo_data_test_put(&file, "GEO!", 4);
+    geo_data_test_put_u32(&file, set->num_polygons);
+    for(unsigned int n = 0; n < set->num_polygons; ++n) {
+        geo_data_test_put_u32(&file, set->polygons[n].num_coordinates);
+        geo_data_test_put(&file, set->polygons[n].coords, sizeof(double) * 2 * set->polygons[n].num_coordinates);
+    }
+    if(trailer) {
+        geo_data_test_put(&file, trailer->bytes, trailer->len);
+    }
+    const char *path = geo_data_test_path(name);
+    FILE *handle = fopen(path, "wb");
+    if(!handle || fwrite(file.bytes, 1, file.len, handle) != file.len || fclose(handle)) {
+        fprintf(stderr, "can't write %s\n", path);
+        exit(2);
+    }
+    free(file.bytes);
+    return path;
+}
+
+static geo_data *geo_data_test_load(const char *path, int quadtree, int robust) {
+    geo_data_options options;
+    geo_data_options_init(&options);
+    options.quadtree = quadtree;
+    options.robust = robust;
+    int status = 0;
+    geo_data *data = geo_data_create_with_options(path, &options, &status);
+    if(!data) {
+        fprintf(stderr, "can't load %s (%d)\n", path, status);
+        exit(2);
+    }
+    return data;
+}
+
+// REFERENCES
+
+static int geo_data_test_valid(const geo_data_test_polygon *polygon) {
+    if(polygon->num_coordinates < 3) {
+        return 0;
+    }
+    for(unsigned int i = 0; i < polygon->num_coordinates * 2; ++i) {
+        if(!isfinite(polygon->coords[i])) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// the classic even odd ray cast, lng half open on every edge
+static int geo_data_test_inside(const geo_data_test_polygon *polygon, double lng, double lat) {
+    const double *c = polygon->coords;
+    int inside = 0;
+    for(unsigned int i = 0, j = polygon->num_coordinates - 1; i < polygon->num_coordinates; j = i++) {
+        double ilng = c[i * 2], ilat = c[i * 2 + 1], jlng = c[j * 2], jlat = c[j * 2 + 1];
+        if(((ilng <= lng && lng < jlng) || (jlng <= lng && lng < ilng)) && lat < (jlat - ilat) * (lng - ilng) / (jlng - ilng) + ilat) {
+            inside = !inside;
+        }
+    }
+    return inside;
+}
+
+static int geo_data_test_lookup(const geo_data_test_set *set, double lng, double lat) {
+    for(unsigned int n = 0; n < set->num_polygons; ++n) {
+        if(geo_data_test_valid(&set->polygons[n]) && geo_data_test_inside(&set->polygons[n], lng, lat)) {
+            return (int)n;
+        }
+    }
+    return -1;
+}
+
+static void geo_data_test_box(const geo_data_test_polygon *polygon, geo_data_box *box) {
+    box->min_lng = box->min_lat = DBL_MAX;
+    box->max_lng = box->max_lat = -DBL_MAX;
+    for(unsigned int i = 0; i < polygon->num_coordinates; ++i) {
+        box->min_lng = fmin(box->min_lng, polygon->coords[i * 2]);
+        box->max_lng = fmax(box->max_lng, polygon->coords[i * 2]);
+        box->min_lat = fmin(box->min_lat, polygon->coords[i * 2 + 1]);
+        box->max_lat = fmax(box->max_lat, polygon->coords[i * 2 + 1]);
+    }
+}
+
+// squared equirectangular distance in lat degrees, lng scaled by kx
+static double geo_data_test_segment_distance2(double px, double py, double ax, double ay, double bx, double by) {
+    double dx = bx - ax, dy = by - ay;
+    double len2 = dx * dx + dy * dy;
+    double t = len2 > 0.0 ? ((px - ax) * dx + (py - ay) * dy) / len2 : 0.0;
+    t = t < 0.0 ? 0.0 : (t > 1.0 ? 1.0 : t);
+    double ex = ax + t * dx - px, ey = ay + t * dy - py;
+    return ex * ex + ey * ey;
+}
+
+static double geo_data_test_edge_distance2(const geo_data_test_polygon *polygon, double lng, double lat, double kx) {
+    const double *c = polygon->coords;
+    double best = DBL_MAX;
+    for(unsigned int i = 0, j = polygon->num_coordinates - 1; i < polygon->num_coordinates; j = i++) {
+        best = fmin(best, geo_data_test_segment_distance2(lng * kx, lat, c[j * 2] * kx, c[j * 2 + 1], c[i * 2] * kx, c[i * 2 + 1]));
+    }
+    return best;
+}
+
+static double geo_data_test_polygon_distance2(const geo_data_test_polygon *polygon, double lng, double lat, double kx) {
+    return geo_data_test_inside(polygon, lng, lat) ? 0.0 : geo_data_test_edge_distance2(polygon, lng, lat, kx);
+}
+
+// segment touching the box, liang barsky
+static int geo_data_test_segment_in_box(double ax, double ay, double bx, double by, const geo_data_box *box) {
+    double dx = bx - ax, dy = by - ay;
+    double p[4] = {-dx, dx, -dy, dy};
+    double q[4] = {ax - box->min_lng, box->max_lng - ax, ay - box->min_lat, box->max_lat - ay};
+    double t0 = 0.0, t1 = 1.0;
+    for(int i = 0; i < 4; ++i) {
+        if(p[i] == 0.0) {
+            if(q[i] < 0.0) {
+                return 0;
+            }
+            continue;
+        }
+        double t = q[i] / p[i];
+        if(p[i] < 0.0) {
+            if(t > t1) return 0;
+            if(t > t0) t0 = t;
+        } else {
+            if(t < t0) return 0;
+            if(t < t1) t1 = t;
+        }
+    }
+    return 1;
+}
+
+static int geo_data_test_polygon_in_box(const geo_data_test_polygon *polygon, const geo_data_box *box) {
+    const double *c = polygon->coords;
+    for(unsigned int i = 0, j = polygon->num_coordinates - 1; i < polygon->num_coordinates; j = i++) {
+        if(geo_data_test_segment_in_box(c[j * 2], c[j * 2 + 1], c[i * 2], c[i * 2 + 1], box)) {
+            return 1;
+        }
+    }
+    return geo_data_test_inside(polygon, box->min_lng, box->min_lat);
+}
+
+static double geo_data_test_orient(double ax, double ay, double bx, double by, double cx, double cy) {
+    return (bx - ax) * (cy - ay) - (by - ay) * (cx - ax);
+}
+
+// r within the box of segment pq, for r already known to be collinear with it
+static int geo_data_test_on_segment(const double *p, const double *q, const double *r) {
+    return fmin(p[0], q[0]) <= r[0] && r[0] <= fmax(p[0], q[0]) && fmin(p[1], q[1]) <= r[1] && r[1] <= fmax(p[1], q[1]);
+}
+
+// closed segments sharing any point, touching and collinear overlaps included
+static int geo_data_test_segments_intersect(const double *a, const double *b, const double *c, const double *d) {
+    double d1 = geo_data_test_orient(c[0], c[1], d[0], d[1], a[0], a[1]);
+    double d2 = geo_data_test_orient(c[0], c[1], d[0], d[1], b[0], b[1]);
+    double d3 = geo_data_test_orient(a[0], a[1], b[0], b[1], c[0], c[1]);
+    double d4 = geo_data_test_orient(a[0], a[1], b[0], b[1], d[0], d[1]);
+    if(((d1 > 0.0 && d2 < 0.0) || (d1 < 0.0 && d2 > 0.0)) && ((d3 > 0.0 && d4 < 0.0) || (d3 < 0.0 && d4 > 0.0))) {
+        return 1;
+    }
+    return (d1 == 0.0 && geo_data_test_on_segment(c, d, a)) || (d2 == 0.0 && geo_data_test_on_segment(c, d, b)) ||
+           (d3 == 0.0 && geo_data_test_on_segment(a, b, c)) || (d4 == 0.0 && geo_data_test_on_segment(a, b, d));
+}
+
+static int geo_data_test_boundaries_touch(const geo_data_test_polygon *polygon, const geo_data_test_polygon *ring) {
+    const double *p = polygon->coords, *q = ring->coords;
+    for(unsigned int i = 0, j = polygon->num_coordinates - 1; i < polygon->num_coordinates; j = i++) {
+        for(unsigned int k = 0, l = ring->num_coordinates - 1; k < ring->num_coordinates; l = k++) {
+            if(geo_data_test_segments_intersect(&p[j * 2], &p[i * 2], &q[l * 2], &q[k * 2])) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+// DATASETS
+
+// jittered tiling whose neighbours share their edges exactly, every edge is split into a few jittered points so the
+// tiles exercise the unrolled kernels. border points sit on the shared edges and on their vertices
+static void geo_data_test_tiles(geo_data_test_set *set, unsigned int side) {
+    double *x = (double *)malloc(sizeof(double) * (side + 1) * (side + 1));
+    double *y = (double *)malloc(sizeof(double) * (side + 1) * (side + 1));
+    double cell_lng = 40.0 / side, cell_lat = 30.0 / side;
+    for(unsigned int r = 0; r <= side; ++r) {
+        for(unsigned int c = 0; c <= side; ++c) {
+            int border = r == 0 || c == 0 || r == side || c == side;
+            x[r * (side + 1) + c] = -20.0 + c * cell_lng + (border ? 0.0 : geo_data_test_uniform(-0.3, 0.3) * cell_lng);
+            y[r * (side + 1) + c] = -15.0 + r * cell_lat + (border ? 0.0 : geo_data_test_uniform(-0.3, 0.3) * cell_lat);
+        }
+    }
+
+    for(unsigned int r = 0; r < side; ++r) {
+        for(unsigned int c = 0; c < side; ++c) {
+            // corners counter clockwise, every edge from its lower vertex index so both tiles split it identically
+            unsigned int corners[4] = {r * (side + 1) + c, r * (side + 1) + c + 1, (r + 1) * (side + 1) + c + 1, (r + 1) * (side + 1) + c};
+            double coords[2 * 4 * 4];
+            unsigned int num_coordinates = 0;
+            for(unsigned int k = 0; k < 4; ++k) {
+                unsigned int a = corners[k], b = corners[(k + 1) % 4];
+                unsigned int lo = a < b ? a : b, hi = a < b ? b : a;
+                unsigned int splits = (lo * 7 + hi * 13) % 4;
+                double points[2 * 3];
+                for(unsigned int s = 0; s < splits; ++s) {
+                    double t = (s + 1.0) / (splits + 1.0);
+                    double wobble = ((int)((lo * 31 + hi * 17 + s * 5) % 11) - 5) * 0.01;
+                    points[s * 2] = x[lo] + (x[hi] - x[lo]) * t - (y[hi] - y[lo]) * wobble;
+                    points[s * 2 + 1] = y[lo] + (y[hi] - y[lo]) * t + (x[hi] - x[lo]) * wobble;
+                }
+                coords[num_coordinates * 2] = x[a];
+                coords[num_coordinates * 2 + 1] = y[a];
+                num_coordinates++;
+                for(unsigned int s = 0; s < splits; ++s) {
+                    unsigned int i = a == lo ? s : splits - 1 - s;
+                    coords[num_coordinates * 2] = points[i * 2];
+                    coords[num_coordinates * 2 + 1] = points[i * 2 + 1];
+                    num_coordinates++;
+                }
+            }
+            geo_data_test_add(set, coords, num_coordinates);
+
+            const geo_data_test_polygon *polygon = &set->polygons[set->num_polygons - 1];
+            for(unsigned int i = 0, j = polygon->num_coordinates - 1; i < polygon->num_coordinates; j = i++) {
+                const double *a = &polygon->coords[j * 2], *b = &polygon->coords[i * 2];
+                static const double ts[] = {0.0, 0.25, 0.5, 0.77};
+                for(unsigned int t = 0; t < sizeof(ts) / sizeof(ts[0]); ++t) {
+                    geo_data_test_add_point(set, a[0] + (b[0] - a[0]) * ts[t], a[1] + (b[1] - a[1]) * ts[t]);
+                }
+            }
+        }
+    }
+    free(x);
+    free(y);
+}
+
+static void geo_data_test_star(geo_data_test_set *set, double lng, double lat, double radius, unsigned int spikes) {
+    double *coords = (double *)calloc(4 * spikes, sizeof(double));
+    for(unsigned int i = 0; i < spikes * 2; ++i) {
+        double angle = M_PI * i / spikes;
+        double r = i & 1 ? radius * geo_data_test_uniform(0.3, 0.6) : radius;
+        coords[i * 2] = lng + r * cos(angle);
+        coords[i * 2 + 1] = lat + r * sin(angle);
+    }
+    geo_data_test_add(set, coords, spikes * 2);
+    for(unsigned int i = 0, j = spikes * 2 - 1; i < spikes * 2; j = i++) {
+        geo_data_test_add_point(set, coords[i * 2], coords[i * 2 + 1]);
+        geo_data_test_add_point(set, (coords[i * 2] + coords[j * 2]) * 0.5, (coords[i * 2 + 1] + coords[j * 2 + 1]) * 0.5);
+    }
+    free(coords);
+}
+
+// overlapping stars and triangles, a polygon large enough for the slab kernel and polygons validation rejects
+static void geo_data_test_stars(geo_data_test_set *set) {
+    for(unsigned int n = 0; n < 40; ++n) {
+        geo_data_test_star(set, geo_data_test_uniform(-40.0, 40.0), geo_data_test_uniform(-30.0, 30.0), geo_data_test_uniform(1.0, 8.0),
+                           3 + (unsigned int)(geo_data_test_random() * 40));
+        if(n == 10) {
+            geo_data_test_star(set, 5.0, 5.0, 20.0, 6000);
+            double two[4] = {0.0, 0.0, 1.0, 1.0};
+            geo_data_test_add(set, two, 2);
+            double broken[6] = {0.0, 0.0, NAN, 1.0, 1.0, 0.0};
+            geo_data_test_add(set, broken, 3);
+        }
+    }
+    for(unsigned int n = 0; n < 30; ++n) {
+        double lng = geo_data_test_uniform(-40.0, 40.0), lat = geo_data_test_uniform(-30.0, 30.0);
+        double triangle[6] = {lng, lat, lng + geo_data_test_uniform(0.5, 3.0), lat, lng, lat + geo_data_test_uniform(0.5, 3.0)};
+        geo_data_test_add(set, triangle, 3);
+    }
+}
+
+// boxes crossing the antimeridian in both notations
+static void geo_data_test_antimeridian(geo_data_test_set *set) {
+    double east[8] = {170.0, -10.0, -170.0, -10.0, -170.0, 10.0, 170.0, 10.0};
+    double unwrapped[8] = {175.0, 20.0, 190.0, 20.0, 190.0, 30.0, 175.0, 30.0};
+    double west[8] = {-180.0, -40.0, -160.0, -40.0, -160.0, -20.0, -180.0, -20.0};
+    double unwrapped_west[8] = {-190.0, -55.0, -170.0, -55.0, -170.0, -45.0, -190.0, -45.0};
+    geo_data_test_add(set, east, 4);
+    geo_data_test_add(set, unwrapped, 4);
+    geo_data_test_add(set, west, 4);
+    geo_data_test_star(set, 179.0, 45.0, 3.0, 9);
+    geo_data_test_add(set, unwrapped_west, 4);
+    for(unsigned int i = 0; i < 2000; ++i) {
+        geo_data_test_add_point(set, geo_data_test_uniform(165.0, 180.0), geo_data_test_uniform(-45.0, 50.0));
+        geo_data_test_add_point(set, geo_data_test_uniform(-180.0, -155.0), geo_data_test_uniform(-45.0, 50.0));
+    }
+}
+
+// TESTS
+
+// random points spread over the set's extent with a margin, interleaved lng/lat
+static double *geo_data_test_random_points(unsigned int num_points, double min_lng, double min_lat, double max_lng, double max_lat) {
+    double *points = (double *)malloc(sizeof(double) * 2 * num_points);
+    for(unsigned int i = 0; i < num_points; ++i) {
+        points[i * 2] = geo_data_test_uniform(min_lng, max_lng);
+        points[i * 2 + 1] = geo_data_test_uniform(min_lat, max_lat);
+    }
+    return points;
+}
+
+// the scan, the quadtree and their robust variants on random and border points. the quadtree has to answer exactly
+// like the scan of its mode everywhere, the modes agree away from borders and the scan agrees with brute force
+static void geo_data_test_lookups(const char *name, const geo_data_test_set *set, const char *path, const double *points,
+                                  unsigned int num_points, int brute) {
+    geo_data *scan = geo_data_test_load(path, 0, 0);
+    geo_data *quad = geo_data_test_load(path, 1, 0);
+    geo_data *robust = geo_data_test_load(path, 0, 1);
+    geo_data *robust_quad = geo_data_test_load(path, 1, 1);
+    geo_data_stats stats;
+    geo_data_get_stats(quad, &stats);
+    CHECK(stats.quad_nodes > 0, "%s: no quadtree built", name);
+
+    unsigned int mismatches[4] = {0, 0, 0, 0};
+    for(unsigned int i = 0; i < num_points; ++i) {
+        double lng = points[i * 2], lat = points[i * 2 + 1];
+        int expected = geo_data_lookup(scan, lng, lat);
+        mismatches[0] += geo_data_lookup(quad, lng, lat) != expected;
+        mismatches[1] += geo_data_lookup(robust, lng, lat) != expected;
+        mismatches[2] += geo_data_lookup(robust_quad, lng, lat) != geo_data_lookup(robust, lng, lat);
+        mismatches[3] += brute && geo_data_test_lookup(set, lng, lat) != expected;
+    }
+    CHECK(mismatches[0] == 0, "%s: quadtree differs from the scan on %u of %u random points", name, mismatches[0], num_points);
+    CHECK(mismatches[1] == 0, "%s: robust differs from the scan on %u of %u random points", name, mismatches[1], num_points);
+    CHECK(mismatches[2] == 0, "%s: robust quadtree differs from the robust scan on %u of %u random points", name, mismatches[2], num_points);
+    CHECK(mismatches[3] == 0, "%s: scan differs from brute force on %u of %u random points", name, mismatches[3], num_points);
+
+    unsigned int border[2] = {0, 0};
+    for(unsigned int i = 0; i < set->num_points; ++i) {
+        double lng = set->points[i * 2], lat = set->points[i * 2 + 1];
+        border[0] += geo_data_lookup(quad, lng, lat) != geo_data_lookup(scan, lng, lat);
+        border[1] += geo_data_lookup(robust_quad, lng, lat) != geo_data_lookup(robust, lng, lat);
+    }
+    CHECK(border[0] == 0, "%s: quadtree differs from the scan on %u of %u border points", name, border[0], set->num_points);
+    CHECK(border[1] == 0, "%s: robust quadtree differs from the robust scan on %u of %u border points", name, border[1], set->num_points);
+
+    geo_data_destroy(scan);
+    geo_data_destroy(quad);
+    geo_data_destroy(robust);
+    geo_data_destroy(robust_quad);
+}
+
+// the rectangles of geo_data_test_antimeridian however they were stored: crossing, unwrapped east past 180 and
+// unwrapped west past -180, every mode against their extents taken one turn either way
+static void geo_data_test_wrapped(const char *path, const double *points, unsigned int num_points) {
+    static const struct {
+        int polygon;
+        double min_lng, min_lat, max_lng, max_lat;
+    } rects[] = {
+        {0, 170.0, -10.0, 190.0, 10.0},
+        {1, 175.0, 20.0, 190.0, 30.0},
+        {2, -180.0, -40.0, -160.0, -20.0},
+        {4, -190.0, -55.0, -170.0, -45.0},
+    };
+    for(int mode = 0; mode < 4; ++mode) {
+        geo_data *data = geo_data_test_load(path, mode & 1, mode >> 1);
+        unsigned int mismatches = 0, hits = 0;
+        for(unsigned int i = 0; i < num_points; ++i) {
+            double lng = points[i * 2], lat = points[i * 2 + 1];
+            if(lat > 40.0) {
+                continue; // the star
+            }
+            int expected = -1;
+            for(unsigned int k = 0; k < sizeof(rects) / sizeof(rects[0]) && expected < 0; ++k) {
+                for(int t = -1; t <= 1; ++t) {
+                    double shifted = lng + t * 360.0;
+                    if(shifted > rects[k].min_lng && shifted < rects[k].max_lng && lat > rects[k].min_lat && lat < rects[k].max_lat) {
+                        expected = rects[k].polygon;
+                    }
+                }
+            }
+            hits += expected >= 0;
+            mismatches += geo_data_lookup(data, lng, lat) != expected;
+        }
+        CHECK(hits > 0, "wrapped: no point inside any rectangle");
+        CHECK(mismatches == 0, "wrapped: mode %d differs from the rectangles on %u of %u points", mode, mismatches, num_points);
+        CHECK(geo_data_lookup(data, 175.0, -50.0) == 4 && geo_data_lookup(data, -175.0, -50.0) == 4,
+              "wrapped: mode %d misses the ring unwrapped west", mode);
+        geo_data_destroy(data);
+    }
+}
+
+// batches sorted and unsorted, large enough for the pool and the morton sort, against single lookups
+static void geo_data_test_batch(const char *name, const char *path, const double *points, unsigned int num_points) {
+    int *results = (int *)malloc(sizeof(int) * num_points);
+    for(int mode = 0; mode < 4; ++mode) {
+        geo_data *data = geo_data_test_load(path, mode & 1, mode >> 1);
+        for(unsigned int flags = 0; flags <= GEO_DATA_BATCH_SPATIAL_ORDER; ++flags) {
+            memset(results, 0x55, sizeof(int) * num_points);
+            geo_data_lookup_batch(data, points, num_points, results, flags);
+            unsigned int mismatches = 0;
+            for(unsigned int i = 0; i < num_points; ++i) {
+                mismatches += results[i] != geo_data_lookup(data, points[i * 2], points[i * 2 + 1]);
+            }
+            CHECK(mismatches == 0, "%s: batch mode %d flags %u differs on %u points", name, mode, flags, mismatches);
+        }
+        geo_data_destroy(data);
+    }
+    free(results);
+}
+
+// a random walk crossing many polygons, transitions against single lookups
+static void geo_data_test_track(const char *name, const char *path, int quadtree) {
+    geo_data *data = geo_data_test_load(path, quadtree, 0);
+    unsigned int num_points = 5000;
+    double *coords = (double *)malloc(sizeof(double) * 2 * num_points);
+    unsigned int *indices = (unsigned int *)malloc(sizeof(unsigned int) * num_points);
+    int *polygons = (int *)malloc(sizeof(int) * num_points);
+    double lng = 0.0, lat = 0.0;
+    for(unsigned int i = 0; i < num_points; ++i) {
+        lng = fmax(-45.0, fmin(45.0, lng + geo_data_test_uniform(-0.4, 0.4)));
+        lat = fmax(-35.0, fmin(35.0, lat + geo_data_test_uniform(-0.4, 0.4)));
+        coords[i * 2] = lng;
+        coords[i * 2 + 1] = lat;
+    }
+
+    unsigned int count = geo_data_classify_track(data, coords, num_points, indices, polygons);
+    unsigned int expected = 0, mismatches = 0;
+    int last = 0;
+    for(unsigned int i = 0; i < num_points; ++i) {
+        int polygon = geo_data_lookup(data, coords[i * 2], coords[i * 2 + 1]);
+        if(i == 0 || polygon != last) {
+            if(expected >= count || indices[expected] != i || polygons[expected] != polygon) {
+                mismatches++;
+            }
+            expected++;
+            last = polygon;
+        }
+    }
+    CHECK(count == expected && mismatches == 0, "%s: track has %u transitions, %u expected, %u differ", name, count, expected, mismatches);
+    free(coords);
+    free(indices);
+    free(polygons);
+    geo_data_destroy(data);
+}
+
+static int geo_data_test_contains(const unsigned int *results, unsigned int num_results, unsigned int n) {
+    for(unsigned int i = 0; i < num_results; ++i) {
+        if(results[i] == n) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int geo_data_test_compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+// query_box, query_radius, nearest and distance_to_boundary against brute force over every valid polygon
+static void geo_data_test_queries(const char *name, const geo_data_test_set *set, const char *path) {
+    geo_data *data = geo_data_test_load(path, 0, 0);
+    unsigned int box_mismatches = 0, radius_mismatches = 0, nearest_mismatches = 0, distance_mismatches = 0;
+    double *distances = (double *)malloc(sizeof(double) * (set->num_polygons ? set->num_polygons : 1));
+    double *sorted = (double *)malloc(sizeof(double) * (set->num_polygons ? set->num_polygons : 1));
+
+    for(unsigned int q = 0; q < 300; ++q) {
+        geo_data_box query;
+        query.min_lng = geo_data_test_uniform(-45.0, 40.0);
+        query.min_lat = geo_data_test_uniform(-35.0, 30.0);
+        query.max_lng = query.min_lng + geo_data_test_uniform(0.0, 6.0);
+        query.max_lat = query.min_lat + geo_data_test_uniform(0.0, 6.0);
+        for(int exact = 0; exact < 2; ++exact) {
+            unsigned int *results = NULL, num_results = 0;
+            CHECK(geo_data_query_box(data, &query, exact, &results, &num_results) == 0, "%s: query_box failed", name);
+            for(unsigned int n = 0; n < set->num_polygons; ++n) {
+                const geo_data_test_polygon *polygon = &set->polygons[n];
+                int expected = 0;
+                if(geo_data_test_valid(polygon)) {
+                    geo_data_box box;
+                    geo_data_test_box(polygon, &box);
+                    expected = box.min_lng <= query.max_lng && box.max_lng >= query.min_lng && box.min_lat <= query.max_lat &&
+                               box.max_lat >= query.min_lat && (!exact || geo_data_test_polygon_in_box(polygon, &query));
+                }
+                box_mismatches += expected != geo_data_test_contains(results, num_results, n);
+            }
+            for(unsigned int i = 1; i < num_results; ++i) {
+                box_mismatches += results[i - 1] >= results[i];
+            }
+            free(results);
+        }
+
+        double lng = geo_data_test_uniform(-45.0, 45.0), lat = geo_data_test_uniform(-35.0, 35.0);
+        double kx = cos(lat * M_PI / 180.0);
+        double meters = geo_data_test_uniform(0.0, 400000.0);
+        double radius = meters / GEO_DATA_TEST_METERS_PER_DEGREE;
+        unsigned int num_valid = 0;
+        double best = DBL_MAX;
+        for(unsigned int n = 0; n < set->num_polygons; ++n) {
+            distances[n] = DBL_MAX;
+            if(geo_data_test_valid(&set->polygons[n])) {
+                distances[n] = sqrt(geo_data_test_polygon_distance2(&set->polygons[n], lng, lat, kx));
+                best = fmin(best, sqrt(geo_data_test_edge_distance2(&set->polygons[n], lng, lat, kx)));
+                num_valid++;
+            }
+        }
+
+        for(int exact = 0; exact < 2; ++exact) {
+            unsigned int *results = NULL, num_results = 0;
+            CHECK(geo_data_query_radius(data, lng, lat, meters, exact, &results, &num_results) == 0, "%s: query_radius failed", name);
+            for(unsigned int n = 0; n < set->num_polygons; ++n) {
+                double d = distances[n];
+                if(!exact && d < DBL_MAX) {
+                    geo_data_box box;
+                    geo_data_test_box(&set->polygons[n], &box);
+                    double gx = fmax(fmax(box.min_lng - lng, lng - box.max_lng), 0.0) * kx;
+                    double gy = fmax(fmax(box.min_lat - lat, lat - box.max_lat), 0.0);
+                    d = sqrt(gx * gx + gy * gy);
+                }
+                // right at the radius either answer is fine
+                if(fabs(d - radius) > 1e-9) {
+                    radius_mismatches += (d <= radius) != geo_data_test_contains(results, num_results, n);
+                }
+            }
+            free(results);
+        }
+
+        int polygons[5];
+        double found[5];
+        int count = geo_data_nearest(data, lng, lat, 5, polygons, found);
+        if(count != (int)(num_valid < 5 ? num_valid : 5)) {
+            nearest_mismatches++;
+        }
+        memcpy(sorted, distances, sizeof(double) * set->num_polygons);
+        qsort(sorted, set->num_polygons, sizeof(double), geo_data_test_compare_doubles);
+        for(int i = 0; i < count; ++i) {
+            double d = found[i] / GEO_DATA_TEST_METERS_PER_DEGREE;
+            nearest_mismatches += fabs(d - sorted[i]) > 1e-9 || fabs(distances[polygons[i]] - d) > 1e-9;
+        }
+
+        geo_data_distance distance;
+        geo_data_distance_to_boundary(data, lng, lat, &distance);
+        distance_mismatches += distance.polygon < 0 || fabs(distance.meters / GEO_DATA_TEST_METERS_PER_DEGREE - best) > 1e-9;
+        if(distance.polygon >= 0) {
+            const geo_data_test_polygon *polygon = &set->polygons[distance.polygon];
+            unsigned int to = (distance.edge + 1) % polygon->num_coordinates;
+            const double *c = polygon->coords;
+            double d = sqrt(geo_data_test_segment_distance2(lng * kx, lat, c[distance.edge * 2] * kx, c[distance.edge * 2 + 1], c[to * 2] * kx,
+                                                            c[to * 2 + 1]));
+            distance_mismatches += fabs(d - best) > 1e-9;
+        }
+    }
+    CHECK(box_mismatches == 0, "%s: query_box differs from brute force %u times", name, box_mismatches);
+    CHECK(radius_mismatches == 0, "%s: query_radius differs from brute force %u times", name, radius_mismatches);
+    CHECK(nearest_mismatches == 0, "%s: nearest differs from brute force %u times", name, nearest_mismatches);
+    CHECK(distance_mismatches == 0, "%s: distance_to_boundary differs from brute force %u times", name, distance_mismatches);
+    free(distances);
+    free(sorted);
+    geo_data_destroy(data);
+}
+
+// nested boxes with PROP and PRNT trailers in either order, and malformed trailers
+static void geo_data_test_trailers(void) {
+    geo_data_test_set set;
+    memset(&set, 0, sizeof(set));
+    double country[8] = {0.0, 0.0, 10.0, 0.0, 10.0, 10.0, 0.0, 10.0};
+    double state[8] = {1.0, 1.0, 5.0, 1.0, 5.0, 5.0, 1.0, 5.0};
+    double county[8] = {2.0, 2.0, 3.0, 2.0, 3.0, 3.0, 2.0, 3.0};
+    double other[8] = {20.0, 0.0, 30.0, 0.0, 30.0, 10.0, 20.0, 10.0};
+    geo_data_test_add(&set, country, 4);
+    geo_data_test_add(&set, state, 4);
+    geo_data_test_add(&set, county, 4);
+    geo_data_test_add(&set, other, 4);
+
+    geo_data_test_buffer props = {NULL, 0};
+    geo_data_test_put(&props, "PROP", 4);
+    geo_data_test_put_u32(&props, 2);
+    char column[32];
+    memset(column, 0, sizeof(column));
+    strcpy(column, "id");
+    geo_data_test_put(&props, column, sizeof(column));
+    geo_data_test_put_u32(&props, 1);
+    for(int64_t n = 0; n < 4; ++n) {
+        int64_t value = 840 + n;
+        geo_data_test_put(&props, &value, sizeof(value));
+    }
+    memset(column, 0, sizeof(column));
+    strcpy(column, "iso");
+    geo_data_test_put(&props, column, sizeof(column));
+    geo_data_test_put_u32(&props, 2);
+    geo_data_test_put_u32(&props, 2); // "US", "FR"
+    unsigned int codes[4] = {0, 0, 0, 1};
+    geo_data_test_put(&props, codes, sizeof(codes));
+    unsigned int ends[3] = {0, 2, 4};
+    geo_data_test_put(&props, ends, sizeof(ends));
+    geo_data_test_put(&props, "USFR", 4);
+
+    geo_data_test_buffer parents = {NULL, 0};
+    geo_data_test_put(&parents, "PRNT", 4);
+    unsigned int links[4] = {GEO_DATA_TEST_PARENT_NONE, 0, 1, GEO_DATA_TEST_PARENT_NONE};
+    geo_data_test_put(&parents, links, sizeof(links));
+
+    for(int order = 0; order < 2; ++order) {
+        geo_data_test_buffer trailer = {NULL, 0};
+        const geo_data_test_buffer *first = order ? &parents : &props, *second = order ? &props : &parents;
+        geo_data_test_put(&trailer, first->bytes, first->len);
+        geo_data_test_put(&trailer, second->bytes, second->len);
+        const char *path = geo_data_test_write("trailers.geo", &set, &trailer);
+        free(trailer.bytes);
+
+        for(int quadtree = 0; quadtree < 2; ++quadtree) {
+            geo_data *data = geo_data_test_load(path, quadtree, 0);
+            CHECK(geo_data_prop_count(data) == 2, "order %d: %u columns", order, geo_data_prop_count(data));
+            CHECK(geo_data_prop_name(data, 1) && strcmp(geo_data_prop_name(data, 1), "iso") == 0, "order %d: wrong column name", order);
+            int id = geo_data_prop_find(data, "id"), iso = geo_data_prop_find(data, "iso");
+            CHECK(id == 0 && iso == 1 && geo_data_prop_find(data, "missing") < 0, "order %d: prop_find", order);
+            int64_t value = 0;
+            unsigned int len = 0;
+            const char *str = geo_data_prop_string(data, iso, 3, &len);
+            CHECK(geo_data_prop_int64(data, id, 2, &value) == 0 && value == 842, "order %d: int64 value", order);
+            CHECK(str && len == 2 && memcmp(str, "FR", 2) == 0, "order %d: string value", order);
+            CHECK(geo_data_prop_int64(data, iso, 0, &value) != 0 && !geo_data_prop_string(data, id, 0, &len), "order %d: column types", order);
+
+            int path_ids[8];
+            unsigned int depth = geo_data_lookup_path(data, 2.5, 2.5, path_ids, 8);
+            CHECK(depth == 3 && path_ids[0] == 0 && path_ids[1] == 1 && path_ids[2] == 2, "order %d: path depth %u", order, depth);
+            depth = geo_data_lookup_path(data, 7.0, 7.0, path_ids, 8);
+            CHECK(depth == 1 && path_ids[0] == 0, "order %d: path outside the state", order);
+            depth = geo_data_lookup_path(data, 25.0, 5.0, path_ids, 8);
+            CHECK(depth == 1 && path_ids[0] == 3, "order %d: path in the other country", order);
+            CHECK(geo_data_lookup_path(data, 50.0, 5.0, path_ids, 8) == 0, "order %d: path outside everything", order);
+            CHECK(geo_data_lookup_path(data, 2.5, 2.5, path_ids, 2) == 2, "order %d: path cut at max_path", order);
+            geo_data_destroy(data);
+        }
+    }
+
+    // a PROP trailer cut short and a hierarchy with a cycle
+    int status = 0;
+    geo_data_test_buffer truncated = {NULL, 0};
+    geo_data_test_put(&truncated, props.bytes, props.len - 3);
+    geo_data *data = geo_data_create(geo_data_test_write("truncated.geo", &set, &truncated), &status);
+    CHECK(!data && status == -1016, "truncated PROP: status %d", status);
+    free(truncated.bytes);
+
+    geo_data_test_buffer cycle = {NULL, 0};
+    geo_data_test_put(&cycle, "PRNT", 4);
+    unsigned int looped[4] = {1, 0, GEO_DATA_TEST_PARENT_NONE, GEO_DATA_TEST_PARENT_NONE};
+    geo_data_test_put(&cycle, looped, sizeof(looped));
+    status = 0;
+    data = geo_data_create(geo_data_test_write("cycle.geo", &set, &cycle), &status);
+    CHECK(!data && status == -1015, "PRNT cycle: status %d", status);
+    free(cycle.bytes);
+
+    geo_data_test_buffer short_parents = {NULL, 0};
+    geo_data_test_put(&short_parents, parents.bytes, parents.len - 4);
+    status = 0;
+    data = geo_data_create(geo_data_test_write("short.geo", &set, &short_parents), &status);
+    CHECK(!data && status == -1015, "truncated PRNT: status %d", status);
+    free(short_parents.bytes);
+
+    free(props.bytes);
+    free(parents.bytes);
+    geo_data_test_free(&set);
+}
+
+// a dataset without polygons answers every query with nothing
+static void geo_data_test_empty(void) {
+    geo_data_test_set set;
+    memset(&set, 0, sizeof(set));
+    const char *path = geo_data_test_write("empty.geo", &set, NULL);
+    for(int quadtree = 0; quadtree < 2; ++quadtree) {
+        geo_data_options options;
+        geo_data_options_init(&options);
+        options.quadtree = quadtree;
+        int status = 0;
+        geo_data *data = geo_data_create_with_options(path, &options, &status);
+        CHECK(data != NULL, "empty: load failed with %d", status);
+        if(!data) {
+            continue;
+        }
+        CHECK(geo_data_num_polygons(data) == 0 && geo_data_lookup(data, 1.0, 1.0) == -1, "empty: lookup");
+        double points[4] = {1.0, 1.0, -5.0, 3.0};
+        int results[2] = {7, 7};
+        geo_data_lookup_batch(data, points, 2, results, GEO_DATA_BATCH_SPATIAL_ORDER);
+        CHECK(results[0] == -1 && results[1] == -1, "empty: batch");
+        unsigned int indices[2];
+        int polygons[2];
+        CHECK(geo_data_classify_track(data, points, 2, indices, polygons) == 1 && polygons[0] == -1, "empty: track");
+        unsigned int *found = NULL, num_found = 7;
+        geo_data_box box = {-10.0, -10.0, 10.0, 10.0};
+        CHECK(geo_data_query_box(data, &box, 1, &found, &num_found) == 0 && num_found == 0, "empty: query_box");
+        free(found);
+        found = NULL;
+        CHECK(geo_data_query_radius(data, 0.0, 0.0, 1000.0, 1, &found, &num_found) == 0 && num_found == 0, "empty: query_radius");
+        free(found);
+        int nearest[1];
+        double meters[1];
+        CHECK(geo_data_nearest(data, 0.0, 0.0, 1, nearest, meters) == 0, "empty: nearest");
+        geo_data_distance distance;
+        geo_data_distance_to_boundary(data, 0.0, 0.0, &distance);
+        CHECK(distance.polygon == -1 && distance.meters == HUGE_VAL, "empty: distance");
+        int path_ids[4];
+        CHECK(geo_data_lookup_path(data, 0.0, 0.0, path_ids, 4) == 0, "empty: path");
+        geo_data_destroy(data);
+    }
+}
+
+// query_ring in both modes with random simple rings, from slivers inside a single tile to ones spanning many polygons,
+// against brute force over every valid polygon
+static void geo_data_test_rings(const char *name, const geo_data_test_set *set, const char *path) {
+    geo_data *data = geo_data_test_load(path, 0, 0);
+    unsigned int mismatches[2] = {0, 0}, matches[2] = {0, 0};
+    double coords[2 * 16];
+    geo_data_test_polygon ring = {0, coords};
+
+    for(unsigned int q = 0; q < 300; ++q) {
+        // vertices at ascending angles around a center keep the ring simple
+        double lng = geo_data_test_uniform(-45.0, 45.0), lat = geo_data_test_uniform(-35.0, 35.0);
+        double radius = q % 3 == 0 ? geo_data_test_uniform(0.05, 0.4) : geo_data_test_uniform(0.4, 8.0);
+        ring.num_coordinates = 3 + q % 12;
+        for(unsigned int i = 0; i < ring.num_coordinates; ++i) {
+            double angle = 2.0 * M_PI * (i + geo_data_test_uniform(0.1, 0.9)) / ring.num_coordinates;
+            double r = radius * geo_data_test_uniform(0.4, 1.0);
+            coords[i * 2] = lng + r * cos(angle);
+            coords[i * 2 + 1] = lat + r * sin(angle);
+        }
+
+        for(int mode = 0; mode < 2; ++mode) {
+            unsigned int *results = NULL, num_results = 0;
+            CHECK(geo_data_query_ring(data, coords, ring.num_coordinates, mode, &results, &num_results) == 0, "%s: query_ring failed", name);
+            for(unsigned int n = 0; n < set->num_polygons; ++n) {
+                const geo_data_test_polygon *polygon = &set->polygons[n];
+                int expected = 0;
+                if(geo_data_test_valid(polygon)) {
+                    int touching = geo_data_test_boundaries_touch(polygon, &ring);
+                    int ring_inside = geo_data_test_inside(polygon, coords[0], coords[1]);
+                    expected = mode == GEO_DATA_RING_WITHIN ? !touching && ring_inside
+                                                            : touching || ring_inside ||
+                                                                  geo_data_test_inside(&ring, polygon->coords[0], polygon->coords[1]);
+                }
+                mismatches[mode] += expected != geo_data_test_contains(results, num_results, n);
+            }
+            for(unsigned int i = 1; i < num_results; ++i) {
+                mismatches[mode] += results[i - 1] >= results[i];
+            }
+            matches[mode] += num_results;
+            free(results);
+        }
+    }
+    CHECK(mismatches[GEO_DATA_RING_INTERSECTS] == 0, "%s: query_ring intersects differs from brute force %u times", name,
+          mismatches[GEO_DATA_RING_INTERSECTS]);
+    CHECK(mismatches[GEO_DATA_RING_WITHIN] == 0, "%s: query_ring within differs from brute force %u times", name,
+          mismatches[GEO_DATA_RING_WITHIN]);
+    CHECK(matches[GEO_DATA_RING_INTERSECTS] > 0 && matches[GEO_DATA_RING_WITHIN] > 0, "%s: query_ring matched %u intersecting, %u within",
+          name, matches[GEO_DATA_RING_INTERSECTS], matches[GEO_DATA_RING_WITHIN]);
+
+    // fewer than 3 points or a non finite coordinate match nothing
+    unsigned int *results = NULL, num_results = 7;
+    CHECK(geo_data_query_ring(data, coords, 2, GEO_DATA_RING_INTERSECTS, &results, &num_results) == 0 && num_results == 0,
+          "%s: query_ring with 2 points", name);
+    free(results);
+    coords[1] = NAN;
+    CHECK(geo_data_query_ring(data, coords, 3, GEO_DATA_RING_INTERSECTS, &results, &num_results) == 0 && num_results == 0,
+          "%s: query_ring with a NaN", name);
+    free(results);
+    geo_data_destroy(data);
+}
+
+// the same file opened through the registry with different options gets a copy prepared with those options, the
+// same options share one copy
+static void geo_data_test_registry(const char *name, const geo_data_test_set *set, const char *path, const double *points,
+                                   unsigned int num_points) {
+    int status = 0;
+    geo_data *plain = geo_data_open(path, NULL, &status);
+    CHECK(plain != NULL, "%s: open failed with %d", name, status);
+    geo_data *again = geo_data_open(path, NULL, &status);
+    CHECK(again == plain, "%s: a second open with the same options isn't shared", name);
+
+    geo_data_box domain = {-5.0, -5.0, 5.0, 5.0};
+    geo_data_options options;
+    geo_data_options_init(&options);
+    options.domain = &domain;
+    geo_data *bounded = geo_data_open(path, &options, &status);
+    CHECK(bounded != NULL && bounded != plain, "%s: the domain option returned the copy opened without it", name);
+    geo_data_box other = {-5.0, -5.0, 6.0, 5.0};
+    options.domain = &other;
+    geo_data *wider = geo_data_open(path, &options, &status);
+    CHECK(wider != NULL && wider != bounded && wider != plain, "%s: a different domain returned the same copy", name);
+    if(plain && bounded && wider) {
+        unsigned int mismatches = 0;
+        for(unsigned int i = 0; i < num_points; ++i) {
+            double lng = points[i * 2], lat = points[i * 2 + 1];
+            int expected = geo_data_test_lookup(set, lng, lat);
+            int inside = fabs(lng) <= 5.0 && fabs(lat) <= 5.0;
+            mismatches += geo_data_lookup(plain, lng, lat) != expected;
+            mismatches += geo_data_lookup(bounded, lng, lat) != (inside ? expected : -1);
+            mismatches += geo_data_lookup(wider, lng, lat) != (inside || (lng > 5.0 && lng <= 6.0 && fabs(lat) <= 5.0) ? expected : -1);
+        }
+        CHECK(mismatches == 0, "%s: %u lookups ignore the domain they were opened with", name, mismatches);
+    }
+
+    geo_data_options_init(&options);
+    options.quadtree = 1;
+    geo_data *quad = geo_data_open(path, &options, &status);
+    geo_data_stats stats;
+    memset(&stats, 0, sizeof(stats));
+    if(quad) {
+        geo_data_get_stats(quad, &stats);
+    }
+    CHECK(quad != NULL && quad != plain && stats.quad_nodes > 0, "%s: the quadtree option returned a copy without a quadtree", name);
+    options.quad_depth = 4;
+    geo_data *shallow = geo_data_open(path, &options, &status);
+    geo_data_stats shallow_stats;
+    memset(&shallow_stats, 0, sizeof(shallow_stats));
+    if(shallow) {
+        geo_data_get_stats(shallow, &shallow_stats);
+    }
+    CHECK(shallow != NULL && shallow != quad && shallow_stats.quad_nodes > 0 && shallow_stats.quad_nodes < stats.quad_nodes,
+          "%s: quad_depth returned the copy built with the default depth", name);
+
+    geo_data_options_init(&options);
+    options.robust = 1;
+    geo_data *robust = geo_data_open(path, &options, &status);
+    geo_data *robust_again = geo_data_open(path, &options, &status);
+    CHECK(robust != NULL && robust != plain && robust_again == robust, "%s: the robust option returned the copy opened without it", name);
+    if(robust && plain) {
+        // points on borders are where exact predicates answer differently
+        geo_data *reference = geo_data_test_load(path, 0, 1);
+        unsigned int mismatches = 0, differences = 0;
+        for(unsigned int i = 0; i < set->num_points; ++i) {
+            double lng = set->points[i * 2], lat = set->points[i * 2 + 1];
+            mismatches += geo_data_lookup(robust, lng, lat) != geo_data_lookup(reference, lng, lat);
+            differences += geo_data_lookup(robust, lng, lat) != geo_data_lookup(plain, lng, lat);
+        }
+        CHECK(mismatches == 0, "%s: the robust open differs from a robust copy on %u border points", name, mismatches);
+        CHECK(differences > 0, "%s: the robust open answers every border point like the plain one", name);
+        geo_data_destroy(reference);
+    }
+
+    char shared_name[64];
+    snprintf(shared_name, sizeof(shared_name), "/geodata-test-registry-%d", (int)getpid());
+    geo_data_options_init(&options);
+    options.shared_name = shared_name;
+    geo_data *shared = geo_data_open(path, &options, &status);
+    memset(&stats, 0, sizeof(stats));
+    if(shared) {
+        geo_data_get_stats(shared, &stats);
+    }
+    CHECK(shared != NULL && shared != plain && stats.storage == GEO_DATA_STORAGE_SHARED,
+          "%s: shared_name returned the private copy, storage %d", name, stats.storage);
+    geo_data *attached = geo_data_open(NULL, &options, &status);
+    CHECK(attached != NULL && attached != plain, "%s: attach by name after a private open failed with %d", name, status);
+    geo_data_release(attached);
+    geo_data_release(shared);
+    shm_unlink(shared_name);
+
+    geo_data_release(robust_again);
+    geo_data_release(robust);
+    geo_data_release(shallow);
+    geo_data_release(quad);
+    geo_data_release(wider);
+    geo_data_release(bounded);
+    geo_data_release(again);
+    geo_data_release(plain);
+}
+
+// several files queried together, each layer against its own brute force. layers open through the registry, so the
+// options must reach them even when the file is already open without them
+static void geo_data_test_layers(const geo_data_test_set *tiles, const char *tiles_path, const geo_data_test_set *stars,
+                                 const char *stars_path, const double *points, unsigned int num_points) {
+    int status = 0;
+    geo_data *plain = geo_data_open(tiles_path, NULL, &status);
+    CHECK(plain != NULL, "layers: open failed with %d", status);
+
+    const char *names[2] = {"tiles", "stars"};
+    const char *paths[2] = {tiles_path, stars_path};
+    geo_data_box domain = {-10.0, -10.0, 10.0, 10.0};
+    geo_data_options options;
+    geo_data_options_init(&options);
+    options.quadtree = 1;
+    options.domain = &domain;
+    unsigned int failed = 7;
+    geo_data_layers *layers = geo_data_layers_open(names, paths, 2, &options, &status, &failed);
+    CHECK(layers != NULL, "layers: open failed with %d at layer %u", status, failed);
+    if(layers) {
+        CHECK(geo_data_layers_count(layers) == 2, "layers: count %u", geo_data_layers_count(layers));
+        CHECK(strcmp(geo_data_layers_name(layers, 0), "tiles") == 0 && strcmp(geo_data_layers_name(layers, 1), "stars") == 0,
+              "layers: names");
+        CHECK(geo_data_layers_name(layers, 2) == NULL && geo_data_layers_get(layers, 2) == NULL, "layers: out of range");
+        CHECK(geo_data_layers_get(layers, 0) != plain, "layers: the tiles layer is the copy opened without its options");
+        for(unsigned int n = 0; n < 2; ++n) {
+            geo_data_stats stats;
+            geo_data_get_stats(geo_data_layers_get(layers, n), &stats);
+            CHECK(stats.quad_nodes > 0, "layers: %s has no quadtree", names[n]);
+        }
+
+        unsigned int mismatches = 0;
+        for(unsigned int i = 0; i < num_points; ++i) {
+            double lng = points[i * 2], lat = points[i * 2 + 1];
+            int inside = fabs(lng) <= 10.0 && fabs(lat) <= 10.0;
+            int results[2] = {-2, -2};
+            geo_data_lookup_all(layers, lng, lat, results);
+            mismatches += results[0] != (inside ? geo_data_test_lookup(tiles, lng, lat) : -1);
+            mismatches += results[1] != (inside ? geo_data_test_lookup(stars, lng, lat) : -1);
+        }
+        CHECK(mismatches == 0, "layers: lookup_all differs on %u of %u answers", mismatches, num_points * 2);
+        geo_data_layers_destroy(layers);
+    }
+
+    // a layer that can't be opened fails the whole set and names itself
+    const char *broken[2] = {tiles_path, geo_data_test_path("missing.geo")};
+    failed = 7;
+    status = 0;
+    layers = geo_data_layers_open(names, broken, 2, NULL, &status, &failed);
+    CHECK(layers == NULL && failed == 1 && status != 0, "layers: missing file, failed %u status %d", failed, status);
+    geo_data_layers_destroy(layers);
+    geo_data_release(plain);
+}
+
+// one process publishes the prepared dataset into a shared memory segment, a second attaches to it by name alone
+static void geo_data_test_shared(const char *path, const double *points, unsigned int num_points) {
+    char name[64];
+    snprintf(name, sizeof(name), "/geodata-test-%d", (int)getpid());
+    geo_data_options options;
+    geo_data_options_init(&options);
+    options.shared_name = name;
+    int status = 0;
+    geo_data *data = geo_data_open(path, &options, &status);
+    CHECK(data != NULL, "shared: publish failed with %d", status);
+    if(!data) {
+        return;
+    }
+    geo_data_stats stats;
+    geo_data_get_stats(data, &stats);
+    CHECK(stats.storage == GEO_DATA_STORAGE_SHARED, "shared: storage %d", stats.storage);
+    int *expected = (int *)malloc(sizeof(int) * num_points);
+    for(unsigned int i = 0; i < num_points; ++i) {
+        expected[i] = geo_data_lookup(data, points[i * 2], points[i * 2 + 1]);
+    }
+
+    fflush(stderr);
+    pid_t child = fork();
+    if(child == 0) {
+        int attach_status = 0;
+        geo_data *attached = geo_data_open(NULL, &options, &attach_status);
+        if(!attached) {
+            _exit(10);
+        }
+        geo_data_get_stats(attached, &stats);
+        unsigned int mismatches = stats.storage != GEO_DATA_STORAGE_SHARED;
+        for(unsigned int i = 0; i < num_points; ++i) {
+            mismatches += geo_data_lookup(attached, points[i * 2], points[i * 2 + 1]) != expected[i];
+        }
+        geo_data_release(attached);
+        _exit(mismatches ? 11 : 0);
+    }
+    int child_status = -1;
+    CHECK(child > 0 && waitpid(child, &child_status, 0) == child, "shared: fork failed");
+    CHECK(WIFEXITED(child_status) && WEXITSTATUS(child_status) == 0, "shared: attach by name failed, child status %d", child_status);
+
+    free(expected);
+    geo_data_release(data);
+    shm_unlink(name);
+}
+
+int main(void) {
+    char dir[] = "/tmp/geodata-test-XXXXXX";
+    if(!mkdtemp(dir)) {
+        perror("mkdtemp");
+        return 2;
+    }
+    snprintf(geo_data_test_dir_, sizeof(geo_data_test_dir_), "%s", dir);
+    CHECK(geo_data_version() == GEO_DATA_VERSION, "library version %d, header %d", geo_data_version(), GEO_DATA_VERSION);
+
+    geo_data_test_set tiles, stars, wrap;
+    memset(&tiles, 0, sizeof(tiles));
+    memset(&stars, 0, sizeof(stars));
+    memset(&wrap, 0, sizeof(wrap));
+    geo_data_test_tiles(&tiles, 24);
+    geo_data_test_stars(&stars);
+    geo_data_test_antimeridian(&wrap);
+    const char *tiles_path = strdup(geo_data_test_write("tiles.geo", &tiles, NULL));
+    const char *stars_path = strdup(geo_data_test_write("stars.geo", &stars, NULL));
+    const char *wrap_path = strdup(geo_data_test_write("wrap.geo", &wrap, NULL));
+    double *points = geo_data_test_random_points(GEO_DATA_TEST_RANDOM, -45.0, -35.0, 45.0, 35.0);
+
+    // before anything starts the pool, so the child is forked from a single threaded process
+    geo_data_test_shared(tiles_path, points, 2000);
+
+    geo_data_test_lookups("tiles", &tiles, tiles_path, points, GEO_DATA_TEST_RANDOM, 1);
+    geo_data_test_lookups("stars", &stars, stars_path, points, GEO_DATA_TEST_RANDOM, 1);
+    double *wrap_points = geo_data_test_random_points(GEO_DATA_TEST_RANDOM, -180.0, -60.0, 180.0, 60.0);
+    geo_data_test_lookups("antimeridian", &wrap, wrap_path, wrap_points, GEO_DATA_TEST_RANDOM, 0);
+    geo_data_test_wrapped(wrap_path, wrap_points, GEO_DATA_TEST_RANDOM);
+
+    geo_data_test_batch("tiles", tiles_path, points, GEO_DATA_TEST_RANDOM);
+    geo_data_test_batch("stars", stars_path, points, GEO_DATA_TEST_RANDOM);
+    geo_data_test_track("tiles", tiles_path, 0);
+    geo_data_test_track("stars", stars_path, 1);
+    geo_data_test_queries("tiles", &tiles, tiles_path);
+    geo_data_test_queries("stars", &stars, stars_path);
+    geo_data_test_rings("tiles", &tiles, tiles_path);
+    geo_data_test_rings("stars", &stars, stars_path);
+    geo_data_test_registry("registry", &tiles, tiles_path, points, 4000);
+    geo_data_test_layers(&tiles, tiles_path, &stars, stars_path, points, 4000);
+    geo_data_test_trailers();
+    geo_data_test_empty();
+
+    free(points);
+    free(wrap_points);
+    const char *names[] = {"tiles.geo", "stars.geo", "wrap.geo", "trailers.geo", "truncated.geo", "cycle.geo", "short.geo", "empty.geo"};
+    for(unsigned int i = 0; i < sizeof(names) / sizeof(names[0]); ++i) {
+        unlink(geo_data_test_path(names[i]));
+    }
+    rmdir(dir);
+    free((void *)tiles_path);
+    free((void *)stars_path);
+    free((void *)wrap_path);
+    geo_data_test_free(&tiles);
+    geo_data_test_free(&stars);
+    geo_data_test_free(&wrap);
+
+    printf("%u checks, %u failed\n", geo_data_test_checks_, geo_data_test_failures_);
+    return geo_data_test_failures_ ? 1 : 0;
+}